@@ -0,0 +1,101 @@
+// Counts heap allocations per submitted task for ThreadPool::execute(),
+// ThreadPool::post() and the previous packaged_task + std::function path.
+//   g++ -std=c++17 -O2 -pthread -I.. alloc_bench.cpp -o alloc_bench
+//   ./alloc_bench [tasks]
+
+#include "../threadpool.hpp"
+#include "bench_util.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+
+std::atomic<long> allocations { 0 };
+
+} // namespace
+
+// The replacements are kept out of line: once inlined, GCC sees malloc()
+// paired with operator delete, or operator new with free(), and warns
+// (-Wmismatched-new-delete).
+__attribute__((noinline)) void * operator new(size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if(void * ptr = std::malloc(size == 0 ? 1 : size))
+    {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+__attribute__((noinline)) void operator delete(void * ptr) noexcept { std::free(ptr); }
+
+__attribute__((noinline)) void operator delete(void * ptr, size_t) noexcept { std::free(ptr); }
+
+namespace
+{
+
+const long kWarmup = 10000;
+
+void wait_for(const std::atomic<long> & done, long target)
+{
+    while(done.load(std::memory_order_acquire) < target)
+    {
+        std::this_thread::yield();
+    }
+}
+
+template<typename Submit>
+void report(const char * name, long tasks, Submit submit)
+{
+    std::atomic<long> done { 0 };
+    ThreadPool pool(2);
+    for(long ii = 0; ii < kWarmup; ++ii)
+    {
+        submit(pool, done);
+    }
+    wait_for(done, kWarmup);
+
+    const long before = allocations.load();
+    Stopwatch sw;
+    for(long ii = 0; ii < tasks; ++ii)
+    {
+        submit(pool, done);
+    }
+    wait_for(done, kWarmup + tasks);
+    const double secs = sw.seconds();
+    const long allocs = allocations.load() - before;
+    std::printf("%-24s %10.3f allocs/task %10.1f ns/task\n", name,
+        double(allocs) / tasks, secs * 1e9 / tasks);
+}
+
+} // namespace
+
+int main(int argc, char * argv[])
+{
+    const long tasks = arg_or(argc, argv, 1, 1000000);
+
+    // What execute() did before: make_shared<packaged_task> around std::bind,
+    // wrapped once more in a std::function.
+    report("legacy packaged_task", tasks, [](ThreadPool & pool, std::atomic<long> & done)
+    {
+        auto task = std::make_shared<std::packaged_task<void()>>(
+            std::bind([&done]() { done.fetch_add(1, std::memory_order_release); }));
+        std::future<void> fut = task->get_future();
+        std::function<void()> fn([task]() { (*task)(); });
+        pool.post(std::move(fn));
+    });
+
+    report("execute()", tasks, [](ThreadPool & pool, std::atomic<long> & done)
+    {
+        pool.execute([&done]() { done.fetch_add(1, std::memory_order_release); });
+    });
+
+    report("post()", tasks, [](ThreadPool & pool, std::atomic<long> & done)
+    {
+        pool.post([&done]() { done.fetch_add(1, std::memory_order_release); });
+    });
+}
@@ -0,0 +1,124 @@
+// Barrier latency as the thread count grows: CyclicBarrier (one shared
+// counter), TreeBarrier (combining tree) and, when built as C++20,
+// std::barrier. Then a phase-parallel stencil on a ThreadPool, run with
+// parallel_phases() and with one parallel_for_blocks() call per phase.
+//   g++ -std=c++20 -O2 -pthread -I.. barrier_bench.cpp -o barrier_bench
+//   ./barrier_bench [phases]
+
+#include "../cyclic_barrier.h"
+#include "../parallel_algorithm.hpp"
+#include "../tree_barrier.h"
+#include "bench_util.hpp"
+
+#include <cstdio>
+#include <vector>
+
+#if __cplusplus >= 202002L
+#include <barrier>
+#endif
+
+namespace
+{
+
+struct Cyclic
+{
+    explicit Cyclic(unsigned parties) : barrier(parties) {}
+    void arrive(unsigned) { barrier.ArriveAndWait(); }
+    CyclicBarrier barrier;
+};
+
+struct Tree
+{
+    explicit Tree(unsigned parties) : barrier(parties) {}
+    void arrive(unsigned id) { barrier.ArriveAndWait(id); }
+    TreeBarrier barrier;
+};
+
+#if __cplusplus >= 202002L
+struct Std
+{
+    explicit Std(unsigned parties) : barrier(parties) {}
+    void arrive(unsigned) { barrier.arrive_and_wait(); }
+    std::barrier<> barrier;
+};
+#endif
+
+template<typename Barrier>
+void phase_latency(const char * name, unsigned threads, long phases)
+{
+    Barrier barrier(threads);
+    std::vector<std::thread> workers;
+    Stopwatch sw;
+    for(unsigned tid = 0; tid < threads; ++tid)
+    {
+        workers.emplace_back([&, tid]()
+        {
+            for(long phase = 0; phase < phases; ++phase)
+            {
+                barrier.arrive(tid);
+            }
+        });
+    }
+    for(auto & thr : workers)
+    {
+        thr.join();
+    }
+    std::printf("%-14s %2u threads  %9.2f us per phase\n", name, threads, sw.seconds() * 1e6 / phases);
+}
+
+// One Jacobi sweep over cells [lo, hi) of a 1-D grid.
+void sweep(const std::vector<double> & src, std::vector<double> & dst, size_t lo, size_t hi)
+{
+    for(size_t ii = std::max<size_t>(lo, 1), end = std::min(hi, src.size() - 1); ii < end; ++ii)
+    {
+        dst[ii] = (src[ii - 1] + src[ii] + src[ii + 1]) / 3;
+    }
+}
+
+void stencil(unsigned workers, long phases)
+{
+    constexpr size_t kCells = 1 << 16;
+    ThreadPool pool(workers - 1);
+    std::vector<double> grids[2] = { std::vector<double>(kCells, 1.0), std::vector<double>(kCells, 1.0) };
+    const size_t chunk = (kCells + workers - 1) / workers;
+
+    Stopwatch sw;
+    parallel_phases(pool, workers, phases, [&](unsigned worker, size_t phase)
+    {
+        sweep(grids[phase % 2], grids[(phase + 1) % 2], worker * chunk, std::min(kCells, (worker + 1) * chunk));
+    });
+    const double phased = sw.seconds();
+
+    sw.reset();
+    for(long phase = 0; phase < phases; ++phase)
+    {
+        parallel_for_blocks(pool, kCells, [&](size_t lo, size_t hi)
+        {
+            sweep(grids[phase % 2], grids[(phase + 1) % 2], lo, hi);
+        }, chunk);
+    }
+    const double forked = sw.seconds();
+    do_not_optimize(grids[0][kCells / 2]);
+    std::printf("stencil        %2u workers  parallel_phases %8.2f us  parallel_for_blocks %8.2f us per phase\n",
+        workers, phased * 1e6 / phases, forked * 1e6 / phases);
+}
+
+} // namespace
+
+int main(int argc, char * argv[])
+{
+    const long phases = arg_or(argc, argv, 1, 2000);
+    for(unsigned threads : { 2u, 4u, 8u, 16u, 32u, 64u })
+    {
+        phase_latency<Cyclic>("CyclicBarrier", threads, phases);
+        phase_latency<Tree>("TreeBarrier", threads, phases);
+#if __cplusplus >= 202002L
+        phase_latency<Std>("std::barrier", threads, phases);
+#endif
+    }
+    for(unsigned workers : { 2u, 4u, 8u })
+    {
+        stencil(workers, phases / 10);
+    }
+    return 0;
+}
@@ -0,0 +1,43 @@
+#ifndef BENCH_UTIL_HPP__
+#define BENCH_UTIL_HPP__
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+class Stopwatch
+{
+public:
+    Stopwatch() : start { std::chrono::steady_clock::now() } {}
+
+    void reset() { start = std::chrono::steady_clock::now(); }
+
+    double seconds() const
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+private:
+    std::chrono::steady_clock::time_point start;
+};
+
+// Parse argv[idx] as a positive count, or fall back to the default.
+inline long arg_or(int argc, char * argv[], int idx, long dflt)
+{
+    if(idx < argc)
+    {
+        long val = std::atol(argv[idx]);
+        if(val > 0) { return val; }
+    }
+    return dflt;
+}
+
+// Keep the optimizer from discarding a computed value.
+template<typename T>
+inline void do_not_optimize(const T & val)
+{
+    asm volatile("" : : "r,m"(val) : "memory");
+}
+
+#endif // BENCH_UTIL_HPP__
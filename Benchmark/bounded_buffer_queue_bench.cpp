@@ -0,0 +1,187 @@
+// BoundedBufferQueue throughput against batch size, with P producers and P
+// consumers using PushBatch/PopBatch (batch 1 is Push/GetFront), against
+// the previous copying queue driven one element at a time. Run with 8-byte
+// items and with 1 KiB messages (std::vector<char>), where copies matter.
+//   g++ -std=c++17 -O2 -pthread -I.. bounded_buffer_queue_bench.cpp -o bounded_buffer_queue_bench
+//   ./bounded_buffer_queue_bench [items per producer] [capacity]
+
+#include "../bounded_buffer_queue.h"
+#include "bench_util.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+// BoundedBufferQueue as it was: copies in and out, one element per lock.
+template<typename T>
+class LegacyQueue
+{
+public:
+    explicit LegacyQueue(unsigned cap) : cap_(cap), stop_(false), get_counter_(0), push_counter_(0) {}
+
+    void GetFront(T * val)
+    {
+        ++get_counter_;
+        std::unique_lock<std::mutex> lck(mtx_);
+        cv1_.wait(lck, [&]() { return stop_ || !queue_.empty(); });
+        if(stop_)
+        {
+            return;
+        }
+        *val = queue_.front(); queue_.pop();
+        --get_counter_;
+        cv2_.notify_one();
+    }
+
+    void Push(T val)
+    {
+        ++push_counter_;
+        std::unique_lock<std::mutex> lck(mtx_);
+        cv2_.wait(lck, [&]() { return stop_ || queue_.size() < cap_; });
+        if(stop_)
+        {
+            return;
+        }
+        queue_.push(val);
+        --push_counter_;
+        cv1_.notify_one();
+    }
+
+    // What a caller had to do for a batch.
+    template<typename It>
+    void PushBatch(It first, size_t count)
+    {
+        for(size_t idx = 0; idx < count; ++idx, ++first)
+        {
+            Push(*first);
+        }
+    }
+
+    template<typename It>
+    size_t PopBatch(It out, size_t count)
+    {
+        for(size_t idx = 0; idx < count; ++idx, ++out)
+        {
+            GetFront(&*out);
+        }
+        return count;
+    }
+
+private:
+    unsigned cap_;
+    bool stop_;
+    std::mutex mtx_;
+    std::queue<T> queue_;
+    std::atomic<int> get_counter_;
+    std::atomic<int> push_counter_;
+    std::condition_variable cv1_;
+    std::condition_variable cv2_;
+};
+
+uint64_t make_item(uint64_t, long ii) { return static_cast<uint64_t>(ii); }
+
+std::vector<char> make_item(const std::vector<char> & proto, long ii)
+{
+    std::vector<char> msg(proto);
+    msg[0] = static_cast<char>(ii);
+    return msg;
+}
+
+char first_byte(uint64_t val) { return static_cast<char>(val); }
+
+char first_byte(const std::vector<char> & msg) { return msg[0]; }
+
+template<typename Queue, typename T>
+void run(const char * name, unsigned pairs, size_t batch, long items, unsigned cap, const T & proto)
+{
+    Queue queue(cap);
+    std::vector<std::thread> threads;
+    Stopwatch sw;
+    for(unsigned tid = 0; tid < pairs; ++tid)
+    {
+        threads.emplace_back([&]()
+        {
+            std::vector<T> buf;
+            for(long ii = 0; ii < items; )
+            {
+                const size_t count = std::min<size_t>(batch, items - ii);
+                if(count == 1)
+                {
+                    queue.Push(make_item(proto, ii));
+                }
+                else
+                {
+                    buf.clear();
+                    for(size_t idx = 0; idx < count; ++idx)
+                    {
+                        buf.push_back(make_item(proto, ii + idx));
+                    }
+                    queue.PushBatch(buf.begin(), count);
+                }
+                ii += count;
+            }
+        });
+        threads.emplace_back([&]()
+        {
+            std::vector<T> buf(batch);
+            char sum = 0;
+            for(long ii = 0; ii < items; )
+            {
+                if(batch == 1)
+                {
+                    queue.GetFront(&buf[0]);
+                    sum += first_byte(buf[0]);
+                    ++ii;
+                    continue;
+                }
+                const size_t popped = queue.PopBatch(buf.begin(), std::min<size_t>(batch, items - ii));
+                for(size_t idx = 0; idx < popped; ++idx)
+                {
+                    sum += first_byte(buf[idx]);
+                }
+                ii += popped;
+            }
+            do_not_optimize(sum);
+        });
+    }
+    for(auto & thr : threads)
+    {
+        thr.join();
+    }
+    std::printf("%-20s %uP%uC  batch %4zu  %8.2f Mitems/s\n", name, pairs, pairs, batch,
+        pairs * items / sw.seconds() / 1e6);
+}
+
+template<typename T>
+void matrix(const char * title, long items, unsigned cap, const T & proto)
+{
+    std::printf("%s\n", title);
+    for(unsigned pairs : { 1u, 4u })
+    {
+        for(size_t batch : { 1, 4, 16, 64, 256 })
+        {
+            run<LegacyQueue<T>>("previous", pairs, batch, items, cap, proto);
+            run<BoundedBufferQueue<T>>("BoundedBufferQueue", pairs, batch, items, cap, proto);
+        }
+    }
+}
+
+} // namespace
+
+int main(int argc, char * argv[])
+{
+    const long items = arg_or(argc, argv, 1, 200000);
+    const unsigned cap = static_cast<unsigned>(arg_or(argc, argv, 2, 1024));
+    matrix("8-byte items", items, cap, uint64_t(0));
+    matrix("1 KiB messages", items / 4, cap, std::vector<char>(1024, 'x'));
+    return 0;
+}
@@ -0,0 +1,92 @@
+// Fans a request out to many subtasks, comparing one execute() per task with
+// ThreadPool::execute_bulk() and ThreadPool::post_batch().
+//   g++ -std=c++17 -O2 -pthread -I.. bulk_bench.cpp -o bulk_bench
+//   ./bulk_bench [rounds] [subtasks]
+
+#include "../threadpool.hpp"
+#include "bench_util.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <vector>
+
+namespace
+{
+
+const unsigned kThreads = 8;
+
+template<typename Round>
+void report(const char * name, ThreadPool::SchedulePolicy policy, long rounds, long subtasks, Round round)
+{
+    ThreadPool pool(kThreads, policy);
+    std::atomic<long> sink { 0 };
+    round(pool, sink, subtasks); // warm up
+    Stopwatch sw;
+    for(long ii = 0; ii < rounds; ++ii)
+    {
+        round(pool, sink, subtasks);
+    }
+    const double secs = sw.seconds();
+    std::printf("%-9s %-16s %10.1f us/round %8.1f ns/task\n",
+        policy == ThreadPool::SchedulePolicy::SHARED_QUEUE ? "shared" : "stealing", name,
+        secs * 1e6 / rounds, secs * 1e9 / (rounds * subtasks));
+}
+
+std::vector<std::function<void()>> make_subtasks(std::atomic<long> & sink, long subtasks)
+{
+    std::vector<std::function<void()>> funcs;
+    funcs.reserve(subtasks);
+    for(long ii = 0; ii < subtasks; ++ii)
+    {
+        funcs.emplace_back([&sink]() { sink.fetch_add(1, std::memory_order_relaxed); });
+    }
+    return funcs;
+}
+
+} // namespace
+
+int main(int argc, char * argv[])
+{
+    const long rounds = arg_or(argc, argv, 1, 50);
+    const long subtasks = arg_or(argc, argv, 2, 10000);
+    const ThreadPool::SchedulePolicy policies[] = {
+        ThreadPool::SchedulePolicy::SHARED_QUEUE,
+        ThreadPool::SchedulePolicy::WORK_STEALING
+    };
+
+    for(auto policy : policies)
+    {
+        report("execute() each", policy, rounds, subtasks,
+            [](ThreadPool & pool, std::atomic<long> & sink, long n)
+            {
+                auto funcs = make_subtasks(sink, n);
+                std::vector<std::future<void>> futs;
+                futs.reserve(n);
+                for(auto & func : funcs)
+                {
+                    futs.push_back(pool.execute(std::move(func)));
+                }
+                for(auto & fut : futs)
+                {
+                    fut.get();
+                }
+            });
+
+        report("execute_bulk()", policy, rounds, subtasks,
+            [](ThreadPool & pool, std::atomic<long> & sink, long n)
+            {
+                auto funcs = make_subtasks(sink, n);
+                for(auto & fut : pool.execute_bulk(funcs.begin(), funcs.end()))
+                {
+                    fut.get();
+                }
+            });
+
+        report("post_batch()", policy, rounds, subtasks,
+            [](ThreadPool & pool, std::atomic<long> & sink, long n)
+            {
+                auto funcs = make_subtasks(sink, n);
+                pool.post_batch(funcs.begin(), funcs.end()).get();
+            });
+    }
+}
@@ -0,0 +1,124 @@
+// Read scaling of DistributedRwLock against RwLock (one shared counter) and
+// std::shared_mutex, with 1 to 64 reader threads doing short read-side
+// critical sections, plus the price writers pay for scanning the slots.
+// Near-linear read scaling needs as many cores as reader threads.
+//   g++ -std=c++17 -O2 -pthread -I.. distributed_rwlock_bench.cpp -o distributed_rwlock_bench
+//   ./distributed_rwlock_bench [milliseconds per run]
+
+#include "../distributed_rwlock.h"
+#include "../rwlock.h"
+#include "bench_util.hpp"
+
+#include <cstdio>
+#include <shared_mutex>
+#include <vector>
+
+namespace
+{
+
+class SharedMutex
+{
+public:
+    void AcquireWrite() { mtx.lock(); }
+    void ReleaseWrite() { mtx.unlock(); }
+    void AcquireRead() { mtx.lock_shared(); }
+    void ReleaseRead() { mtx.unlock_shared(); }
+
+private:
+    std::shared_mutex mtx;
+};
+
+struct WideDistributedRwLock : DistributedRwLock
+{
+    WideDistributedRwLock() : DistributedRwLock(64) {}
+};
+
+template<typename Lock>
+void reads(const char * name, unsigned threads, long millis)
+{
+    Lock lock;
+    long table[8] = {};
+    std::atomic<bool> go { false };
+    std::atomic<bool> stop { false };
+    std::vector<long> ops(threads);
+    std::vector<std::thread> workers;
+    for(unsigned tid = 0; tid < threads; ++tid)
+    {
+        workers.emplace_back([&, tid]()
+        {
+            while(!go.load(std::memory_order_acquire));
+            long local = 0, sum = 0;
+            while(!stop.load(std::memory_order_relaxed))
+            {
+                lock.AcquireRead();
+                for(long entry : table)
+                {
+                    sum += entry;
+                }
+                lock.ReleaseRead();
+                ++local;
+            }
+            do_not_optimize(sum);
+            ops[tid] = local;
+        });
+    }
+
+    Stopwatch sw;
+    go.store(true, std::memory_order_release);
+    std::this_thread::sleep_for(std::chrono::milliseconds(millis));
+    stop.store(true);
+    for(auto & thr : workers)
+    {
+        thr.join();
+    }
+    const double secs = sw.seconds();
+
+    long total = 0;
+    for(long count : ops)
+    {
+        total += count;
+    }
+    std::printf("%-22s %2u readers %8.2f Mreads/s %8.2f Mreads/s per thread\n",
+        name, threads, total / secs / 1e6, total / secs / 1e6 / threads);
+}
+
+template<typename Lock>
+void writes(const char * name, long millis)
+{
+    Lock lock;
+    long table[8] = {};
+    long count = 0;
+    Stopwatch sw;
+    while(sw.seconds() * 1e3 < millis)
+    {
+        for(int ii = 0; ii < 1000; ++ii)
+        {
+            lock.AcquireWrite();
+            ++table[ii & 7];
+            lock.ReleaseWrite();
+        }
+        count += 1000;
+    }
+    do_not_optimize(table);
+    std::printf("%-22s uncontended write %7.1f ns\n", name, sw.seconds() * 1e9 / count);
+}
+
+} // namespace
+
+int main(int argc, char * argv[])
+{
+    const long millis = arg_or(argc, argv, 1, 200);
+    std::printf("hardware threads: %u\n", std::thread::hardware_concurrency());
+    for(unsigned threads : { 1u, 2u, 4u, 8u, 16u, 32u, 64u })
+    {
+        reads<RwLock>("RwLock", threads, millis);
+        reads<DistributedRwLock>("DistributedRwLock", threads, millis);
+        reads<WideDistributedRwLock>("DistributedRwLock(64)", threads, millis);
+        reads<SharedMutex>("std::shared_mutex", threads, millis);
+    }
+    writes<RwLock>("RwLock", millis);
+    writes<DistributedRwLock>("DistributedRwLock", millis);
+    writes<WideDistributedRwLock>("DistributedRwLock(64)", millis);
+    writes<SharedMutex>("std::shared_mutex", millis);
+    return 0;
+}
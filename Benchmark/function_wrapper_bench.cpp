@@ -0,0 +1,140 @@
+// FunctionWrapper with inline storage vs. the previous heap-only wrapper and
+// std::function: construct + call + destroy, and a FIFO that moves wrappers
+// through a std::deque the way ThreadPool's queues do.
+//   g++ -std=c++17 -O2 -pthread -I.. function_wrapper_bench.cpp -o function_wrapper_bench
+//   ./function_wrapper_bench [iterations]
+
+#include "../function_wrapper.hpp"
+#include "bench_util.hpp"
+
+#include <array>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <memory>
+
+namespace
+{
+
+// The wrapper as it was before inline storage: one block-pool allocation per
+// callable and a virtual call.
+class LegacyFunctionWrapper
+{
+private:
+    struct ImplBase
+    {
+        virtual void call() = 0;
+        virtual ~ImplBase() noexcept {}
+    };
+
+    template<typename Func>
+    struct ImplType : ImplBase
+    {
+        Func _func;
+        ImplType(Func && func) : _func { std::move(func) } {}
+
+        virtual void call() override { _func(); }
+
+        static void * operator new(size_t size) { return BlockPool::allocate(size); }
+        static void operator delete(void * ptr, size_t size) { BlockPool::deallocate(ptr, size); }
+    };
+
+public:
+    LegacyFunctionWrapper() = default;
+
+    template<typename Func, typename = std::enable_if_t<!std::is_same<std::decay_t<Func>, LegacyFunctionWrapper>::value>>
+    LegacyFunctionWrapper(Func && func) :
+        impl { new ImplType<std::decay_t<Func>>(std::decay_t<Func>(std::forward<Func>(func))) }
+        {}
+
+    LegacyFunctionWrapper(LegacyFunctionWrapper &&) noexcept = default;
+
+    LegacyFunctionWrapper & operator=(LegacyFunctionWrapper &&) noexcept = default;
+
+    void operator()() { impl->call(); }
+
+private:
+    std::unique_ptr<ImplBase> impl;
+};
+
+// A callable with Bytes of captured state.
+template<size_t Bytes>
+struct Payload
+{
+    std::array<long, Bytes / sizeof(long)> data;
+    long * sink;
+
+    void operator()() { *sink += data[0]; }
+};
+
+template<typename Wrapper, size_t Bytes>
+double construct_call(long iterations)
+{
+    long sink = 0;
+    Payload<Bytes> payload {};
+    payload.sink = &sink;
+    Stopwatch sw;
+    for(long ii = 0; ii < iterations; ++ii)
+    {
+        payload.data[0] = ii;
+        Wrapper func(payload);
+        func();
+    }
+    const double secs = sw.seconds();
+    do_not_optimize(sink);
+    return secs * 1e9 / iterations;
+}
+
+template<typename Wrapper, size_t Bytes>
+double queue_through(long iterations)
+{
+    const long depth = 1024;
+    long sink = 0;
+    Payload<Bytes> payload {};
+    payload.sink = &sink;
+    std::deque<Wrapper> queue;
+    Stopwatch sw;
+    for(long ii = 0; ii < iterations; ++ii)
+    {
+        payload.data[0] = ii;
+        queue.emplace_back(payload);
+        if(long(queue.size()) >= depth)
+        {
+            Wrapper func = std::move(queue.front());
+            queue.pop_front();
+            func();
+        }
+    }
+    const double secs = sw.seconds();
+    do_not_optimize(sink);
+    return secs * 1e9 / iterations;
+}
+
+template<size_t Bytes>
+void run(long iterations)
+{
+    std::printf("%3zu-byte capture    construct+call  deque push/pop\n", sizeof(Payload<Bytes>));
+    std::printf("  std::function       %8.1f ns    %8.1f ns\n",
+        construct_call<std::function<void()>, Bytes>(iterations), queue_through<std::function<void()>, Bytes>(iterations));
+    std::printf("  legacy wrapper      %8.1f ns    %8.1f ns\n",
+        construct_call<LegacyFunctionWrapper, Bytes>(iterations), queue_through<LegacyFunctionWrapper, Bytes>(iterations));
+    std::printf("  FunctionWrapper<48> %8.1f ns    %8.1f ns\n",
+        construct_call<BasicFunctionWrapper<48>, Bytes>(iterations), queue_through<BasicFunctionWrapper<48>, Bytes>(iterations));
+    std::printf("  FunctionWrapper<64> %8.1f ns    %8.1f ns\n",
+        construct_call<BasicFunctionWrapper<64>, Bytes>(iterations), queue_through<BasicFunctionWrapper<64>, Bytes>(iterations));
+}
+
+} // namespace
+
+int main(int argc, char * argv[])
+{
+    const long iterations = arg_or(argc, argv, 1, 10000000);
+    std::printf("sizeof: std::function %zu, legacy %zu, FunctionWrapper<48> %zu, <64> %zu\n",
+        sizeof(std::function<void()>), sizeof(LegacyFunctionWrapper),
+        sizeof(BasicFunctionWrapper<48>), sizeof(BasicFunctionWrapper<64>));
+    run<8>(iterations);
+    run<40>(iterations);
+    run<56>(iterations);
+    run<128>(iterations);
+    return 0;
+}
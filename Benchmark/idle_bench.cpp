@@ -0,0 +1,86 @@
+// Wake-up latency and CPU cost of ThreadPool idle strategies. Tasks arrive
+// one at a time with a pause between them, so the pool goes idle before
+// each one; latency is measured from submission to the task starting.
+//   g++ -std=c++17 -O2 -pthread -I.. idle_bench.cpp -o idle_bench
+//   ./idle_bench [tasks] [gap in us]
+
+#include "../threadpool.hpp"
+#include "bench_util.hpp"
+
+#include <sys/resource.h>
+
+#include <cstdio>
+
+namespace
+{
+
+using Clock = ThreadPool::Clock;
+
+double cpu_seconds()
+{
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+void run(const char * name, ThreadPool::SchedulePolicy policy, ThreadPool::IdleStrategy strategy,
+         long tasks, long gap_us)
+{
+    LatencyHistogram latency;
+    ThreadPool pool(2, policy);
+    pool.set_idle_strategy(strategy);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+    const double cpu_start = cpu_seconds();
+    Stopwatch watch;
+    for(long ii = 0; ii < tasks; ++ii)
+    {
+        std::atomic<bool> done { false };
+        const auto submitted = Clock::now();
+        pool.post([&latency, &done, submitted]()
+        {
+            latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - submitted).count());
+            done.store(true, std::memory_order_release);
+        });
+        while(!done.load(std::memory_order_acquire))
+        {
+            std::this_thread::yield();
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(gap_us));
+    }
+    const double wall = watch.seconds();
+    const double cpu = cpu_seconds() - cpu_start;
+
+    const auto snap = latency.snapshot();
+    std::printf("%-14s %-22s p50 %8.1f us  p99 %8.1f us  cpu %5.2f cores\n",
+        policy == ThreadPool::SchedulePolicy::SHARED_QUEUE ? "shared queue" : "work stealing", name,
+        snap.percentile(50) / 1e3, snap.percentile(99) / 1e3, cpu / wall);
+}
+
+} // namespace
+
+int main(int argc, char * argv[])
+{
+    const long tasks = arg_or(argc, argv, 1, 2000);
+    const long gap_us = arg_or(argc, argv, 2, 50);
+
+    struct Named
+    {
+        const char * name;
+        ThreadPool::IdleStrategy strategy;
+    };
+    const Named strategies[] = {
+        { "park", { 0, 0 } },
+        { "yield 100 + park", { 0, 100 } },
+        { "spin 20k + park", { 20000, 0 } },
+        { "spin 20k + yield 100", { 20000, 100 } },
+    };
+    for(auto policy : { ThreadPool::SchedulePolicy::SHARED_QUEUE, ThreadPool::SchedulePolicy::WORK_STEALING })
+    {
+        for(const auto & entry : strategies)
+        {
+            run(entry.name, policy, entry.strategy, tasks, gap_us);
+        }
+    }
+    return 0;
+}
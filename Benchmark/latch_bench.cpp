@@ -0,0 +1,179 @@
+// CountdownLatch and CyclicBarrier against the previous mutex latch and,
+// when built as C++20, std::latch and std::barrier:
+//  - cost of an uncontended countdown,
+//  - time from the last countdown until every sleeping waiter is back
+//    (the previous latch only wakes one waiter, so it runs with one),
+//  - time per phase for threads looping on a barrier.
+//   g++ -std=c++20 -O2 -pthread -I.. latch_bench.cpp -o latch_bench
+//   ./latch_bench [rounds]
+
+#include "../countdown_latch.h"
+#include "../cyclic_barrier.h"
+#include "bench_util.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <vector>
+
+#if __cplusplus >= 202002L
+#include <barrier>
+#include <latch>
+#endif
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+// CountdownLatch as it was.
+class LegacyLatch
+{
+public:
+    explicit LegacyLatch(int count) : count_(count) {}
+
+    void Wait()
+    {
+        std::unique_lock<std::mutex> lck(mtx_);
+        cv_.wait(lck, [this]() { return count_ == 0; });
+    }
+
+    void Countdown()
+    {
+        std::unique_lock<std::mutex> lck(mtx_);
+        if(--count_ == 0)
+        {
+            cv_.notify_one();
+        }
+    }
+
+private:
+    int count_;
+    std::mutex mtx_;
+    std::condition_variable cv_;
+};
+
+#if __cplusplus >= 202002L
+class StdLatch
+{
+public:
+    explicit StdLatch(int count) : latch(count) {}
+    void Wait() { latch.wait(); }
+    void Countdown() { latch.count_down(); }
+
+private:
+    std::latch latch;
+};
+
+class StdBarrier
+{
+public:
+    explicit StdBarrier(int parties) : barrier(parties) {}
+    void ArriveAndWait() { barrier.arrive_and_wait(); }
+
+private:
+    std::barrier<> barrier;
+};
+#endif
+
+template<typename Latch>
+void countdown_cost(const char * name)
+{
+    constexpr int kCount = 1000000;
+    Latch latch(kCount);
+    Stopwatch sw;
+    for(int ii = 0; ii < kCount; ++ii)
+    {
+        latch.Countdown();
+    }
+    const double secs = sw.seconds();
+    latch.Wait();
+    std::printf("%-16s countdown %6.1f ns\n", name, secs * 1e9 / kCount);
+}
+
+template<typename Latch>
+void wake_latency(const char * name, unsigned waiters, long rounds)
+{
+    std::vector<double> worst;
+    for(long round = 0; round < rounds; ++round)
+    {
+        Latch latch(1);
+        std::vector<Clock::time_point> woke(waiters);
+        std::vector<std::thread> threads;
+        for(unsigned tid = 0; tid < waiters; ++tid)
+        {
+            threads.emplace_back([&, tid]()
+            {
+                latch.Wait();
+                woke[tid] = Clock::now();
+            });
+        }
+        // Let the waiters fall asleep.
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        const auto start = Clock::now();
+        latch.Countdown();
+        for(auto & thr : threads)
+        {
+            thr.join();
+        }
+        const auto last = *std::max_element(woke.begin(), woke.end());
+        worst.push_back(std::chrono::duration<double, std::micro>(last - start).count());
+    }
+    std::sort(worst.begin(), worst.end());
+    std::printf("%-16s %2u waiters  all awake after p50 %7.1f us  p90 %7.1f us\n",
+        name, waiters, worst[worst.size() / 2], worst[worst.size() * 9 / 10]);
+}
+
+template<typename Barrier>
+void phase_time(const char * name, unsigned threads, long phases)
+{
+    Barrier barrier(threads);
+    std::vector<std::thread> workers;
+    Stopwatch sw;
+    for(unsigned tid = 0; tid < threads; ++tid)
+    {
+        workers.emplace_back([&]()
+        {
+            for(long phase = 0; phase < phases; ++phase)
+            {
+                barrier.ArriveAndWait();
+            }
+        });
+    }
+    for(auto & thr : workers)
+    {
+        thr.join();
+    }
+    std::printf("%-16s %2u threads  %8.2f us per phase\n", name, threads, sw.seconds() * 1e6 / phases);
+}
+
+} // namespace
+
+int main(int argc, char * argv[])
+{
+    const long rounds = arg_or(argc, argv, 1, 100);
+    countdown_cost<LegacyLatch>("legacy latch");
+    countdown_cost<CountdownLatch>("CountdownLatch");
+#if __cplusplus >= 202002L
+    countdown_cost<StdLatch>("std::latch");
+#endif
+
+    wake_latency<LegacyLatch>("legacy latch", 1, rounds);
+    for(unsigned waiters : { 1u, 4u, 16u })
+    {
+        wake_latency<CountdownLatch>("CountdownLatch", waiters, rounds);
+#if __cplusplus >= 202002L
+        wake_latency<StdLatch>("std::latch", waiters, rounds);
+#endif
+    }
+
+    for(unsigned threads : { 2u, 4u, 8u })
+    {
+        phase_time<CyclicBarrier>("CyclicBarrier", threads, rounds * 100);
+#if __cplusplus >= 202002L
+        phase_time<StdBarrier>("std::barrier", threads, rounds * 100);
+#endif
+    }
+    return 0;
+}
@@ -0,0 +1,132 @@
+// MpmcRingQueue against BoundedBufferQueue with P producers and P consumers
+// (1P1C, 4P4C, 16P16C):
+//  - throughput: every producer pushes n integers, every consumer pops n;
+//  - latency: the same with each item stamped when it is pushed, recording
+//    push-to-pop time at the consumer.
+//   g++ -std=c++17 -O2 -pthread -I.. mpmc_ring_queue_bench.cpp -o mpmc_ring_queue_bench
+//   ./mpmc_ring_queue_bench [items per producer] [capacity]
+
+#include "../bounded_buffer_queue.h"
+#include "../latency_histogram.hpp"
+#include "../mpmc_ring_queue.h"
+#include "bench_util.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+const char * matrix(unsigned pairs)
+{
+    static char label[16];
+    std::snprintf(label, sizeof(label), "%uP%uC", pairs, pairs);
+    return label;
+}
+
+uint64_t now_ns()
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        Clock::now().time_since_epoch()).count());
+}
+
+// Starts pairs producer/consumer pairs on one queue and waits for them.
+template<typename Queue, typename Produce, typename Consume>
+double run(Queue & queue, unsigned pairs, Produce produce, Consume consume)
+{
+    std::vector<std::thread> threads;
+    Stopwatch sw;
+    for(unsigned tid = 0; tid < pairs; ++tid)
+    {
+        threads.emplace_back([&, tid]() { consume(queue, tid); });
+        threads.emplace_back([&]() { produce(queue); });
+    }
+    for(auto & thr : threads)
+    {
+        thr.join();
+    }
+    return sw.seconds();
+}
+
+template<typename Queue>
+void throughput(const char * name, unsigned pairs, long items, unsigned cap)
+{
+    Queue queue(cap);
+    const double secs = run(queue, pairs, [items](Queue & q)
+    {
+        for(long ii = 0; ii < items; ++ii)
+        {
+            q.Push(static_cast<uint64_t>(ii));
+        }
+    },
+    [items](Queue & q, unsigned)
+    {
+        uint64_t val = 0;
+        uint64_t sum = 0;
+        for(long ii = 0; ii < items; ++ii)
+        {
+            q.GetFront(&val);
+            sum += val;
+        }
+        do_not_optimize(sum);
+    });
+    std::printf("%-18s %-6s  %8.2f Mops/s\n", name, matrix(pairs), pairs * items / secs / 1e6);
+}
+
+template<typename Queue>
+void latency(const char * name, unsigned pairs, long items, unsigned cap)
+{
+    Queue queue(cap);
+    std::vector<std::unique_ptr<LatencyHistogram>> hists;
+    for(unsigned tid = 0; tid < pairs; ++tid)
+    {
+        hists.emplace_back(new LatencyHistogram());
+    }
+    run(queue, pairs, [items](Queue & q)
+    {
+        for(long ii = 0; ii < items; ++ii)
+        {
+            q.Push(now_ns());
+        }
+    },
+    [&hists, items](Queue & q, unsigned tid)
+    {
+        uint64_t stamp = 0;
+        for(long ii = 0; ii < items; ++ii)
+        {
+            q.GetFront(&stamp);
+            hists[tid]->record_single_writer(now_ns() - stamp);
+        }
+    });
+    LatencyHistogram::Snapshot all;
+    for(const auto & hist : hists)
+    {
+        all.merge(hist->snapshot());
+    }
+    std::printf("%-18s %-6s  push-to-pop p50 %9.1f us  p99 %9.1f us  max %9.1f us\n", name, matrix(pairs),
+        all.percentile(50) / 1e3, all.percentile(99) / 1e3, all.max / 1e3);
+}
+
+} // namespace
+
+int main(int argc, char * argv[])
+{
+    const long items = arg_or(argc, argv, 1, 200000);
+    const unsigned cap = static_cast<unsigned>(arg_or(argc, argv, 2, 1024));
+    for(unsigned pairs : { 1u, 4u, 16u })
+    {
+        throughput<BoundedBufferQueue<uint64_t>>("BoundedBufferQueue", pairs, items, cap);
+        throughput<MpmcRingQueue<uint64_t>>("MpmcRingQueue", pairs, items, cap);
+    }
+    for(unsigned pairs : { 1u, 4u, 16u })
+    {
+        latency<BoundedBufferQueue<uint64_t>>("BoundedBufferQueue", pairs, items, cap);
+        latency<MpmcRingQueue<uint64_t>>("MpmcRingQueue", pairs, items, cap);
+    }
+    return 0;
+}
@@ -0,0 +1,96 @@
+// Compares parallel_for / parallel_transform / parallel_reduce /
+// parallel_inclusive_scan with serial loops and, when built with
+// -DBENCH_STD_PAR (libstdc++ also needs -ltbb), with std::execution::par.
+//   g++ -std=c++17 -O2 -pthread -I.. parallel_algorithm_bench.cpp -o parallel_algorithm_bench
+//   ./parallel_algorithm_bench [elements] [threads]
+
+#include "../parallel_algorithm.hpp"
+#include "bench_util.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <numeric>
+#include <vector>
+
+#ifdef BENCH_STD_PAR
+#include <execution>
+#endif
+
+namespace
+{
+
+const int kRepeat = 5;
+
+template<typename Func>
+double best_of(Func func)
+{
+    double best = 1e30;
+    for(int ii = 0; ii < kRepeat; ++ii)
+    {
+        Stopwatch sw;
+        func();
+        best = std::min(best, sw.seconds());
+    }
+    return best * 1e3;
+}
+
+void row(const char * name, double serial, double pool, double std_par)
+{
+    if(std_par < 0)
+    {
+        std::printf("%-12s %10.2f %10.2f %12s\n", name, serial, pool, "n/a");
+    }
+    else
+    {
+        std::printf("%-12s %10.2f %10.2f %12.2f\n", name, serial, pool, std_par);
+    }
+}
+
+} // namespace
+
+int main(int argc, char * argv[])
+{
+    const size_t n = arg_or(argc, argv, 1, 1 << 24);
+    const unsigned threads = arg_or(argc, argv, 2, std::max(1u, std::thread::hardware_concurrency()));
+    ThreadPool pool(threads, ThreadPool::SchedulePolicy::WORK_STEALING);
+
+    std::vector<double> in(n), out(n);
+    std::iota(in.begin(), in.end(), 0.0);
+    auto heavy = [](double x) { return std::sqrt(x) * std::sin(x); };
+
+    std::printf("%zu elements, %u pool threads, best of %d, in ms\n", n, threads, kRepeat);
+    std::printf("%-12s %10s %10s %12s\n", "algorithm", "serial", "pool", "std::par");
+
+    double std_par = -1;
+
+#ifdef BENCH_STD_PAR
+    std_par = best_of([&]() { std::for_each(std::execution::par, out.begin(), out.end(), [](double & x) { x += 1; }); });
+#endif
+    row("for", best_of([&]() { for(double & x : out) { x += 1; } }),
+        best_of([&]() { parallel_for(pool, out.begin(), out.end(), [](double & x) { x += 1; }); }),
+        std_par);
+
+#ifdef BENCH_STD_PAR
+    std_par = best_of([&]() { std::transform(std::execution::par, in.begin(), in.end(), out.begin(), heavy); });
+#endif
+    row("transform", best_of([&]() { std::transform(in.begin(), in.end(), out.begin(), heavy); }),
+        best_of([&]() { parallel_transform(pool, in.begin(), in.end(), out.begin(), heavy); }),
+        std_par);
+
+    double sum = 0;
+#ifdef BENCH_STD_PAR
+    std_par = best_of([&]() { sum = std::reduce(std::execution::par, in.begin(), in.end(), 0.0); });
+#endif
+    row("reduce", best_of([&]() { sum = std::accumulate(in.begin(), in.end(), 0.0); }),
+        best_of([&]() { sum = parallel_reduce(pool, in.begin(), in.end(), 0.0, std::plus<double>()); }),
+        std_par);
+    do_not_optimize(sum);
+
+#ifdef BENCH_STD_PAR
+    std_par = best_of([&]() { std::inclusive_scan(std::execution::par, in.begin(), in.end(), out.begin()); });
+#endif
+    row("scan", best_of([&]() { std::partial_sum(in.begin(), in.end(), out.begin()); }),
+        best_of([&]() { parallel_inclusive_scan(pool, in.begin(), in.end(), out.begin(), std::plus<double>()); }),
+        std_par);
+}
@@ -0,0 +1,230 @@
+// Memory and throughput of ThreadsafeList with the one-byte CompactLock per
+// node against the previous std::mutex per node, plus raw lock throughput
+// of CompactLock, std::mutex and Spinlock.
+//   g++ -std=c++17 -O2 -pthread -I.. parking_lot_bench.cpp -o parking_lot_bench
+//   ./parking_lot_bench [milliseconds per run]
+
+#include "../Threadsafe Data Structure/threadsafe_list.hpp"
+#include "../compact_lock.hpp"
+#include "../spinlock.hpp"
+#include "bench_util.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace
+{
+
+std::atomic<size_t> heap_bytes { 0 };
+
+} // namespace
+
+void * operator new(size_t size)
+{
+    heap_bytes.fetch_add(size, std::memory_order_relaxed);
+    if(void * ptr = std::malloc(size))
+    {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void * ptr) noexcept { std::free(ptr); }
+
+void operator delete(void * ptr, size_t) noexcept { std::free(ptr); }
+
+namespace
+{
+
+// ThreadsafeList as it was (a std::mutex in every node), with its compile
+// errors fixed.
+template<typename T>
+class LegacyList
+{
+private:
+    struct Node
+    {
+        std::mutex mtx;
+        std::shared_ptr<T> data;
+        std::unique_ptr<Node> next;
+
+        Node() = default;
+
+        Node(const T & val) :
+            data { std::make_shared<T>(val) }
+            {}
+    };
+
+public:
+    ~LegacyList()
+    {
+        std::unique_ptr<Node> current = std::move(head.next);
+        while(current)
+        {
+            current = std::move(current->next);
+        }
+    }
+
+    void push_front(const T & val)
+    {
+        std::unique_ptr<Node> new_node = std::make_unique<Node>(val);
+        std::lock_guard<std::mutex> lck(head.mtx);
+        new_node->next = std::move(head.next);
+        head.next = std::move(new_node);
+    }
+
+    template<typename Predicate>
+    std::shared_ptr<T> find_first_of(Predicate pred)
+    {
+        Node * current = &head;
+        std::unique_lock<std::mutex> lck(head.mtx);
+        while(Node * const next = current->next.get())
+        {
+            std::unique_lock<std::mutex> next_lck(next->mtx);
+            lck.unlock();
+            if(pred(*next->data))
+            {
+                return next->data;
+            }
+            current = next;
+            lck = std::move(next_lck);
+        }
+        return std::shared_ptr<T>();
+    }
+
+private:
+    Node head;
+};
+
+// Same layout as the list nodes, to report their size.
+template<typename Lock>
+struct NodeLayout
+{
+    Lock mtx;
+    std::shared_ptr<int> data;
+    std::unique_ptr<NodeLayout> next;
+};
+
+template<typename List>
+void list_run(const char * name, unsigned threads, long millis)
+{
+    constexpr int kElements = 2000;
+    List list;
+    const size_t before = heap_bytes.load();
+    for(int ii = 0; ii < kElements; ++ii)
+    {
+        list.push_front(ii);
+    }
+    const double bytes_per_element = double(heap_bytes.load() - before) / kElements;
+
+    std::atomic<bool> go { false };
+    std::atomic<bool> stop { false };
+    std::vector<long> ops(threads);
+    std::vector<std::thread> workers;
+    for(unsigned tid = 0; tid < threads; ++tid)
+    {
+        workers.emplace_back([&, tid]()
+        {
+            while(!go.load(std::memory_order_acquire));
+            unsigned rng = tid + 1;
+            long local = 0;
+            while(!stop.load(std::memory_order_relaxed))
+            {
+                rng = rng * 1103515245 + 12345;
+                const int key = (rng >> 8) % kElements;
+                auto found = list.find_first_of([key](int val) { return val == key; });
+                do_not_optimize(found);
+                ++local;
+            }
+            ops[tid] = local;
+        });
+    }
+
+    Stopwatch sw;
+    go.store(true, std::memory_order_release);
+    std::this_thread::sleep_for(std::chrono::milliseconds(millis));
+    stop.store(true);
+    for(auto & thr : workers)
+    {
+        thr.join();
+    }
+    const double secs = sw.seconds();
+
+    long total = 0;
+    for(long count : ops)
+    {
+        total += count;
+    }
+    std::printf("%-22s %2u threads  %6.1f heap bytes/element  %8.0f finds/s (%.1f M node locks/s)\n",
+        name, threads, bytes_per_element, total / secs, total * kElements / 2 / secs / 1e6);
+}
+
+template<typename Lock>
+void lock_run(const char * name, unsigned threads, long millis)
+{
+    Lock lock;
+    long shared = 0;
+    std::atomic<bool> go { false };
+    std::atomic<bool> stop { false };
+    std::vector<long> ops(threads);
+    std::vector<std::thread> workers;
+    for(unsigned tid = 0; tid < threads; ++tid)
+    {
+        workers.emplace_back([&, tid]()
+        {
+            while(!go.load(std::memory_order_acquire));
+            long local = 0;
+            while(!stop.load(std::memory_order_relaxed))
+            {
+                {
+                    std::lock_guard<Lock> lck(lock);
+                    ++shared;
+                }
+                ++local;
+            }
+            ops[tid] = local;
+        });
+    }
+
+    Stopwatch sw;
+    go.store(true, std::memory_order_release);
+    std::this_thread::sleep_for(std::chrono::milliseconds(millis));
+    stop.store(true);
+    for(auto & thr : workers)
+    {
+        thr.join();
+    }
+    const double secs = sw.seconds();
+    do_not_optimize(shared);
+
+    long total = 0;
+    for(long count : ops)
+    {
+        total += count;
+    }
+    std::printf("%-22s %2u threads  %3zu bytes  %8.2f Mops/s\n", name, threads, sizeof(Lock), total / secs / 1e6);
+}
+
+} // namespace
+
+int main(int argc, char * argv[])
+{
+    const long millis = arg_or(argc, argv, 1, 200);
+    std::printf("node size: std::mutex %zu bytes, CompactLock %zu bytes\n",
+        sizeof(NodeLayout<std::mutex>), sizeof(NodeLayout<CompactLock>));
+    for(unsigned threads : { 1u, 4u, 16u })
+    {
+        list_run<LegacyList<int>>("ThreadsafeList (mutex)", threads, millis);
+        list_run<ThreadsafeList<int>>("ThreadsafeList", threads, millis);
+    }
+    for(unsigned threads : { 1u, 4u, 16u })
+    {
+        lock_run<std::mutex>("std::mutex", threads, millis);
+        lock_run<Spinlock>("Spinlock", threads, millis);
+        lock_run<CompactLock>("CompactLock", threads, millis);
+    }
+    return 0;
+}
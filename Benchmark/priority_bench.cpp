@@ -0,0 +1,83 @@
+// Queue-wait latency of short latency-critical tasks sharing a ThreadPool
+// with a flood of background work: one FIFO vs. priority lanes.
+//   g++ -std=c++17 -O2 -pthread -I.. priority_bench.cpp -o priority_bench
+//   ./priority_bench [critical tasks] [background tasks]
+
+#include "../threadpool.hpp"
+#include "bench_util.hpp"
+
+#include <cstdio>
+
+namespace
+{
+
+using Clock = ThreadPool::Clock;
+
+void spin_for(std::chrono::microseconds dur)
+{
+    const auto end = Clock::now() + dur;
+    while(Clock::now() < end);
+}
+
+uint64_t since_ns(Clock::time_point start)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+}
+
+void print(const char * name, const LatencyHistogram::Snapshot & snap)
+{
+    std::printf("%-28s %8llu tasks  p50 %9.1f us  p99 %9.1f us  max %9.1f us\n", name,
+        (unsigned long long)snap.count, snap.percentile(50) / 1e3, snap.percentile(99) / 1e3, snap.max / 1e3);
+}
+
+void run(bool lanes, long critical, long background)
+{
+    ThreadPool pool(4);
+    LatencyHistogram critical_wait;
+    for(long ii = 0; ii < background; ++ii)
+    {
+        if(lanes)
+        {
+            pool.post(ThreadPool::Priority::BACKGROUND, spin_for, std::chrono::microseconds(100));
+        }
+        else
+        {
+            pool.post(spin_for, std::chrono::microseconds(100));
+        }
+    }
+
+    std::vector<std::future<void>> futs;
+    for(long ii = 0; ii < critical; ++ii)
+    {
+        const auto submitted = Clock::now();
+        auto task = [&critical_wait, submitted]() { critical_wait.record(since_ns(submitted)); };
+        futs.push_back(lanes ? pool.execute(ThreadPool::Priority::CRITICAL, task) : pool.execute(task));
+        spin_for(std::chrono::microseconds(200));
+    }
+    for(auto & fut : futs)
+    {
+        fut.get();
+    }
+
+    std::printf("%s\n", lanes ? "priority lanes:" : "single FIFO:");
+    print("  critical (measured)", critical_wait.snapshot());
+    if(lanes)
+    {
+        print("  pool CRITICAL lane", pool.queue_wait(ThreadPool::Priority::CRITICAL));
+        print("  pool BACKGROUND lane", pool.queue_wait(ThreadPool::Priority::BACKGROUND));
+    }
+    else
+    {
+        print("  pool NORMAL lane", pool.queue_wait(ThreadPool::Priority::NORMAL));
+    }
+}
+
+} // namespace
+
+int main(int argc, char * argv[])
+{
+    const long critical = arg_or(argc, argv, 1, 2000);
+    const long background = arg_or(argc, argv, 2, 8000);
+    run(false, critical, background);
+    run(true, critical, background);
+}
@@ -0,0 +1,92 @@
+// Lock acquisition latency distribution and fairness of Spinlock, the FIFO
+// locks in queue_lock.hpp and std::mutex. Every thread repeatedly takes the
+// lock, does a short critical section and some work outside it; the time
+// from calling lock() to holding the lock goes into a histogram.
+//   g++ -std=c++17 -O2 -pthread -I.. queue_lock_bench.cpp -o queue_lock_bench
+//   ./queue_lock_bench [milliseconds per run]
+
+#include "../latency_histogram.hpp"
+#include "../queue_lock.hpp"
+#include "../spinlock.hpp"
+#include "bench_util.hpp"
+
+#include <cstdio>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+template<typename Lock>
+void run(const char * name, unsigned threads, long millis)
+{
+    Lock lock;
+    long shared = 0;
+    LatencyHistogram wait;
+    std::atomic<bool> go { false };
+    std::atomic<bool> stop { false };
+    std::vector<long> ops(threads);
+    std::vector<std::thread> workers;
+    for(unsigned tid = 0; tid < threads; ++tid)
+    {
+        workers.emplace_back([&, tid]()
+        {
+            while(!go.load(std::memory_order_acquire));
+            long local = 0;
+            long noise = tid;
+            while(!stop.load(std::memory_order_relaxed))
+            {
+                const auto start = Clock::now();
+                lock.lock();
+                const auto acquired = Clock::now();
+                shared += noise;
+                lock.unlock();
+                wait.record(std::chrono::duration_cast<std::chrono::nanoseconds>(acquired - start).count());
+                for(int ii = 0; ii < 50; ++ii)
+                {
+                    noise = noise * 6364136223846793005L + 1;
+                }
+                ++local;
+            }
+            ops[tid] = local;
+        });
+    }
+
+    go.store(true, std::memory_order_release);
+    std::this_thread::sleep_for(std::chrono::milliseconds(millis));
+    stop.store(true);
+    for(auto & thr : workers)
+    {
+        thr.join();
+    }
+    do_not_optimize(shared);
+
+    long least = ops[0], most = ops[0];
+    for(long count : ops)
+    {
+        least = std::min(least, count);
+        most = std::max(most, count);
+    }
+    const auto snap = wait.snapshot();
+    std::printf("%-12s %2u threads  p50 %8.2f us  p99 %9.2f us  p99.9 %9.2f us  max %9.2f us  ops min/max %.2f\n",
+        name, threads, snap.percentile(50) / 1e3, snap.percentile(99) / 1e3, snap.percentile(99.9) / 1e3,
+        snap.max / 1e3, double(least) / std::max(1L, most));
+}
+
+} // namespace
+
+int main(int argc, char * argv[])
+{
+    const long millis = arg_or(argc, argv, 1, 300);
+    for(unsigned threads : { 2u, 4u, 16u })
+    {
+        run<Spinlock>("Spinlock", threads, millis);
+        run<TicketLock>("TicketLock", threads, millis);
+        run<MCSLock>("MCSLock", threads, millis);
+        run<CLHLock>("CLHLock", threads, millis);
+        run<std::mutex>("std::mutex", threads, millis);
+    }
+    return 0;
+}
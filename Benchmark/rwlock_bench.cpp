@@ -0,0 +1,182 @@
+// Reader scaling of RwLock: the previous all-mutex version, the atomic fast
+// path with reader and writer preference, and std::shared_mutex, with 1 to
+// 64 reader threads. A second run adds one writer to show how many writes
+// get through (writer starvation).
+//   g++ -std=c++17 -O2 -pthread -I.. rwlock_bench.cpp -o rwlock_bench
+//   ./rwlock_bench [milliseconds per run]
+
+#include "../rwlock.h"
+#include "bench_util.hpp"
+
+#include <cstdio>
+#include <shared_mutex>
+#include <vector>
+
+namespace
+{
+
+// RwLock as it was: the mutex is taken on every acquire and release.
+class LegacyRwLock
+{
+public:
+    void AcquireWrite()
+    {
+        std::unique_lock<std::mutex> lck(mtx);
+        wCv.wait(lck, [&]() { return counter == 0; });
+        --counter;
+    }
+
+    void ReleaseWrite()
+    {
+        std::unique_lock<std::mutex> lck(mtx);
+        counter = 0;
+        rCv.notify_all();
+    }
+
+    void AcquireRead()
+    {
+        std::unique_lock<std::mutex> lck(mtx);
+        rCv.wait(lck, [&]() { return counter >= 0; });
+        ++counter;
+    }
+
+    void ReleaseRead()
+    {
+        std::unique_lock<std::mutex> lck(mtx);
+        --counter;
+        wCv.notify_one();
+    }
+
+private:
+    std::mutex mtx;
+    std::condition_variable rCv;
+    std::condition_variable wCv;
+    std::atomic<int> counter { 0 };
+};
+
+class SharedMutex
+{
+public:
+    void AcquireWrite() { mtx.lock(); }
+    void ReleaseWrite() { mtx.unlock(); }
+    void AcquireRead() { mtx.lock_shared(); }
+    void ReleaseRead() { mtx.unlock_shared(); }
+
+private:
+    std::shared_mutex mtx;
+};
+
+struct ReaderPreferring : RwLock
+{
+    ReaderPreferring() : RwLock(RwLock::Preference::READER) {}
+};
+
+struct WriterPreferring : RwLock
+{
+    WriterPreferring() : RwLock(RwLock::Preference::WRITER) {}
+};
+
+// A small routing table: readers sum a few entries, the writer bumps them.
+struct Table
+{
+    long entries[8] = {};
+};
+
+template<typename Lock>
+void run(const char * name, unsigned readers, bool with_writer, long millis)
+{
+    Lock lock;
+    Table table;
+    std::atomic<bool> go { false };
+    std::atomic<bool> stop { false };
+    std::vector<long> reads(readers);
+    long writes = 0;
+    std::vector<std::thread> threads;
+    for(unsigned tid = 0; tid < readers; ++tid)
+    {
+        threads.emplace_back([&, tid]()
+        {
+            while(!go.load(std::memory_order_acquire));
+            long local = 0, sum = 0;
+            while(!stop.load(std::memory_order_relaxed))
+            {
+                lock.AcquireRead();
+                for(long entry : table.entries)
+                {
+                    sum += entry;
+                }
+                lock.ReleaseRead();
+                ++local;
+            }
+            do_not_optimize(sum);
+            reads[tid] = local;
+        });
+    }
+    if(with_writer)
+    {
+        threads.emplace_back([&]()
+        {
+            while(!go.load(std::memory_order_acquire));
+            while(!stop.load(std::memory_order_relaxed))
+            {
+                lock.AcquireWrite();
+                for(long & entry : table.entries)
+                {
+                    ++entry;
+                }
+                lock.ReleaseWrite();
+                ++writes;
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            }
+        });
+    }
+
+    Stopwatch sw;
+    go.store(true, std::memory_order_release);
+    std::this_thread::sleep_for(std::chrono::milliseconds(millis));
+    stop.store(true);
+    for(auto & thr : threads)
+    {
+        thr.join();
+    }
+    const double secs = sw.seconds();
+
+    long total = 0;
+    for(long count : reads)
+    {
+        total += count;
+    }
+    if(with_writer)
+    {
+        std::printf("%-18s %2u readers %8.2f Mreads/s %8.0f writes/s\n", name, readers, total / secs / 1e6, writes / secs);
+    }
+    else
+    {
+        std::printf("%-18s %2u readers %8.2f Mreads/s\n", name, readers, total / secs / 1e6);
+    }
+}
+
+template<typename Lock>
+void scale(const char * name, bool with_writer, long millis)
+{
+    for(unsigned readers : { 1u, 2u, 4u, 8u, 16u, 32u, 64u })
+    {
+        run<Lock>(name, readers, with_writer, millis);
+    }
+}
+
+} // namespace
+
+int main(int argc, char * argv[])
+{
+    const long millis = arg_or(argc, argv, 1, 200);
+    for(bool with_writer : { false, true })
+    {
+        std::printf(with_writer ? "\nreaders plus one writer every 100us\n" : "readers only\n");
+        scale<LegacyRwLock>("legacy RwLock", with_writer, millis);
+        scale<ReaderPreferring>("RwLock (reader)", with_writer, millis);
+        scale<WriterPreferring>("RwLock (writer)", with_writer, millis);
+        scale<SharedMutex>("std::shared_mutex", with_writer, millis);
+    }
+    return 0;
+}
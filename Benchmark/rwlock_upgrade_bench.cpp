@@ -0,0 +1,207 @@
+// Read-mostly get-or-create on a hash map: about 1% of lookups miss and
+// insert. Compares taking the write lock for every call, a read lookup that
+// retries under the write lock on a miss, a read lookup that upgrades on a
+// miss, and std::shared_mutex with the retry pattern. The RwLock miss paths are
+// kept out of line so that their hit paths are compiled the same.
+//   g++ -std=c++17 -O2 -pthread -I.. rwlock_upgrade_bench.cpp -o rwlock_upgrade_bench
+//   ./rwlock_upgrade_bench [milliseconds per run]
+
+#include "../rwlock.h"
+#include "bench_util.hpp"
+
+#include <cstdio>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+
+using Map = std::unordered_map<long, long>;
+
+long make_value(long key) { return key * 2 + 1; }
+
+// What lookup-then-maybe-insert paths did without upgrades.
+struct WriteAlways
+{
+    RwLock lock;
+    Map map;
+
+    long get_or_create(long key)
+    {
+        lock.AcquireWrite();
+        auto it = map.find(key);
+        if(it == map.end())
+        {
+            it = map.emplace(key, make_value(key)).first;
+        }
+        const long value = it->second;
+        lock.ReleaseWrite();
+        return value;
+    }
+};
+
+// Read first; on a miss drop the read lock, take the write lock and look
+// again, since someone may have inserted in between.
+struct ReadThenWrite
+{
+    RwLock lock;
+    Map map;
+
+    long get_or_create(long key)
+    {
+        lock.AcquireRead();
+        auto it = map.find(key);
+        if(it != map.end())
+        {
+            const long value = it->second;
+            lock.ReleaseRead();
+            return value;
+        }
+        lock.ReleaseRead();
+        return create(key);
+    }
+
+    __attribute__((noinline)) long create(long key)
+    {
+        lock.AcquireWrite();
+        auto it = map.find(key);
+        if(it == map.end())
+        {
+            it = map.emplace(key, make_value(key)).first;
+        }
+        const long value = it->second;
+        lock.ReleaseWrite();
+        return value;
+    }
+};
+
+// Read first; on a miss look again as an upgradeable reader, which does not
+// stop other readers, and only upgrade to insert.
+struct ReadThenUpgrade
+{
+    RwLock lock;
+    Map map;
+
+    long get_or_create(long key)
+    {
+        lock.AcquireRead();
+        auto it = map.find(key);
+        if(it != map.end())
+        {
+            const long value = it->second;
+            lock.ReleaseRead();
+            return value;
+        }
+        lock.ReleaseRead();
+        return create(key);
+    }
+
+    __attribute__((noinline)) long create(long key)
+    {
+        lock.AcquireUpgradeable();
+        auto it = map.find(key);
+        if(it != map.end())
+        {
+            const long value = it->second;
+            lock.ReleaseUpgradeable();
+            return value;
+        }
+        lock.UpgradeToWrite();
+        it = map.emplace(key, make_value(key)).first;
+        lock.DowngradeToRead();
+        const long value = it->second;
+        lock.ReleaseRead();
+        return value;
+    }
+};
+
+struct SharedMutexReadThenWrite
+{
+    std::shared_mutex mtx;
+    Map map;
+
+    long get_or_create(long key)
+    {
+        {
+            std::shared_lock<std::shared_mutex> lck(mtx);
+            auto it = map.find(key);
+            if(it != map.end())
+            {
+                return it->second;
+            }
+        }
+        std::lock_guard<std::shared_mutex> lck(mtx);
+        return map.emplace(key, make_value(key)).first->second;
+    }
+};
+
+template<typename Cache>
+void run(const char * name, unsigned threads, long millis)
+{
+    constexpr long kWarmKeys = 4096;
+    Cache cache;
+    for(long key = 0; key < kWarmKeys; ++key)
+    {
+        cache.get_or_create(key);
+    }
+    std::atomic<long> next_key { kWarmKeys };
+    std::atomic<bool> go { false };
+    std::atomic<bool> stop { false };
+    std::vector<long> ops(threads);
+    std::vector<std::thread> workers;
+    for(unsigned tid = 0; tid < threads; ++tid)
+    {
+        workers.emplace_back([&, tid]()
+        {
+            while(!go.load(std::memory_order_acquire));
+            unsigned long rng = tid * 0x9E3779B97F4A7C15UL + 1;
+            long local = 0, sum = 0;
+            while(!stop.load(std::memory_order_relaxed))
+            {
+                rng = rng * 6364136223846793005UL + 1442695040888963407UL;
+                const unsigned long draw = rng >> 33;
+                // 1 in 100 calls asks for a key that does not exist yet.
+                const long key = draw % 100 == 0 ?
+                    next_key.fetch_add(1, std::memory_order_relaxed) : long(draw % kWarmKeys);
+                sum += cache.get_or_create(key);
+                ++local;
+            }
+            do_not_optimize(sum);
+            ops[tid] = local;
+        });
+    }
+
+    Stopwatch sw;
+    go.store(true, std::memory_order_release);
+    std::this_thread::sleep_for(std::chrono::milliseconds(millis));
+    stop.store(true);
+    for(auto & thr : workers)
+    {
+        thr.join();
+    }
+    const double secs = sw.seconds();
+
+    long total = 0;
+    for(long count : ops)
+    {
+        total += count;
+    }
+    std::printf("%-26s %2u threads %8.2f Mops/s\n", name, threads, total / secs / 1e6);
+}
+
+} // namespace
+
+int main(int argc, char * argv[])
+{
+    const long millis = arg_or(argc, argv, 1, 200);
+    for(unsigned threads : { 1u, 4u, 16u, 64u })
+    {
+        run<WriteAlways>("RwLock write always", threads, millis);
+        run<ReadThenWrite>("RwLock read, then write", threads, millis);
+        run<ReadThenUpgrade>("RwLock read, then upgrade", threads, millis);
+        run<SharedMutexReadThenWrite>("std::shared_mutex", threads, millis);
+    }
+    return 0;
+}
@@ -0,0 +1,150 @@
+// Read throughput for a small market-data style snapshot guarded by
+// SeqLock, RwLock and std::shared_mutex, with 1 to 64 reader threads and one
+// writer publishing a new snapshot every 10us. Reads are also checked for
+// torn snapshots.
+//   g++ -std=c++17 -O2 -pthread -I.. seqlock_bench.cpp -o seqlock_bench
+//   ./seqlock_bench [milliseconds per run]
+
+#include "../rwlock.h"
+#include "../seqlock.hpp"
+#include "bench_util.hpp"
+
+#include <cstdio>
+#include <shared_mutex>
+#include <vector>
+
+namespace
+{
+
+struct Quote
+{
+    long sequence;
+    double bid;
+    double ask;
+    double last;
+};
+
+class SeqLocked
+{
+public:
+    Quote read() const { return quote.load(); }
+    void write(const Quote & value) { quote.store(value); }
+
+private:
+    SeqLock<Quote> quote;
+};
+
+class RwLocked
+{
+public:
+    Quote read()
+    {
+        lock.AcquireRead();
+        Quote value = quote;
+        lock.ReleaseRead();
+        return value;
+    }
+
+    void write(const Quote & value)
+    {
+        lock.AcquireWrite();
+        quote = value;
+        lock.ReleaseWrite();
+    }
+
+private:
+    RwLock lock;
+    Quote quote {};
+};
+
+class SharedMutexLocked
+{
+public:
+    Quote read()
+    {
+        std::shared_lock<std::shared_mutex> lck(mtx);
+        return quote;
+    }
+
+    void write(const Quote & value)
+    {
+        std::lock_guard<std::shared_mutex> lck(mtx);
+        quote = value;
+    }
+
+private:
+    std::shared_mutex mtx;
+    Quote quote {};
+};
+
+template<typename Guarded>
+void run(const char * name, unsigned readers, long millis)
+{
+    Guarded guarded;
+    std::atomic<bool> go { false };
+    std::atomic<bool> stop { false };
+    std::vector<long> ops(readers);
+    std::atomic<long> torn { 0 };
+    long writes = 0;
+    std::vector<std::thread> threads;
+    for(unsigned tid = 0; tid < readers; ++tid)
+    {
+        threads.emplace_back([&, tid]()
+        {
+            while(!go.load(std::memory_order_acquire));
+            long local = 0, bad = 0;
+            while(!stop.load(std::memory_order_relaxed))
+            {
+                const Quote quote = guarded.read();
+                bad += quote.sequence != 0 &&
+                    (quote.bid != quote.sequence || quote.ask != quote.sequence + 1 || quote.last != quote.sequence);
+                ++local;
+            }
+            ops[tid] = local;
+            torn += bad;
+        });
+    }
+    threads.emplace_back([&]()
+    {
+        while(!go.load(std::memory_order_acquire));
+        while(!stop.load(std::memory_order_relaxed))
+        {
+            ++writes;
+            const double price = writes;
+            guarded.write(Quote { writes, price, price + 1, price });
+            std::this_thread::sleep_for(std::chrono::microseconds(10));
+        }
+    });
+
+    Stopwatch sw;
+    go.store(true, std::memory_order_release);
+    std::this_thread::sleep_for(std::chrono::milliseconds(millis));
+    stop.store(true);
+    for(auto & thr : threads)
+    {
+        thr.join();
+    }
+    const double secs = sw.seconds();
+
+    long total = 0;
+    for(long count : ops)
+    {
+        total += count;
+    }
+    std::printf("%-18s %2u readers %8.2f Mreads/s %8.0f writes/s  torn %ld\n",
+        name, readers, total / secs / 1e6, writes / secs, torn.load());
+}
+
+} // namespace
+
+int main(int argc, char * argv[])
+{
+    const long millis = arg_or(argc, argv, 1, 200);
+    for(unsigned readers : { 1u, 2u, 4u, 8u, 16u, 32u, 64u })
+    {
+        run<SeqLocked>("SeqLock", readers, millis);
+        run<RwLocked>("RwLock", readers, millis);
+        run<SharedMutexLocked>("std::shared_mutex", readers, millis);
+    }
+    return 0;
+}
@@ -0,0 +1,88 @@
+// spawn_task() on the shared executor vs. the previous thread-per-call
+// version. A burst of spawns measures spawn rate and how long tasks wait to
+// start; spawning one task at a time measures the spawn-to-completion round
+// trip.
+//   g++ -std=c++17 -O2 -pthread -I.. spawn_bench.cpp -o spawn_bench
+//   ./spawn_bench [tasks]
+
+#include "../spawn_task.hpp"
+#include "bench_util.hpp"
+
+#include <cstdio>
+#include <vector>
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+// spawn_task() as it was: one detached std::thread per call.
+template<typename Func, typename ... Args>
+std::future<std::result_of_t<Func(Args...)>> legacy_spawn_task(Func && func, Args && ... args)
+{
+    using result_type = std::result_of_t<Func(Args...)>;
+    std::packaged_task<result_type(Args && ...)> task(std::move(func));
+    std::future<result_type> fut(task.get_future());
+    std::thread thr(std::move(task), std::move(args)...);
+    thr.detach();
+    return fut;
+}
+
+template<typename Spawn>
+void run(const char * name, long tasks, Spawn spawn)
+{
+    LatencyHistogram start_latency;
+    std::vector<std::future<void>> futs;
+    futs.reserve(tasks);
+    Stopwatch sw;
+    for(long ii = 0; ii < tasks; ++ii)
+    {
+        const auto submitted = Clock::now();
+        futs.push_back(spawn([&start_latency](Clock::time_point submitted)
+        {
+            start_latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - submitted).count());
+        }, submitted));
+    }
+    const double spawn_secs = sw.seconds();
+    for(auto & fut : futs)
+    {
+        fut.get();
+    }
+    const double total_secs = sw.seconds();
+
+    // One task at a time: spawn, then wait for it.
+    LatencyHistogram round_trip;
+    for(long ii = 0; ii < tasks / 10; ++ii)
+    {
+        const auto submitted = Clock::now();
+        spawn([](Clock::time_point) {}, submitted).get();
+        round_trip.record(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - submitted).count());
+    }
+
+    const auto burst = start_latency.snapshot();
+    const auto single = round_trip.snapshot();
+    std::printf("%-22s burst: %9.0f spawns/s %9.0f tasks/s, start p50 %8.1f us | single: p50 %7.1f us p99 %7.1f us\n",
+        name, tasks / spawn_secs, tasks / total_secs, burst.percentile(50) / 1e3,
+        single.percentile(50) / 1e3, single.percentile(99) / 1e3);
+}
+
+} // namespace
+
+int main(int argc, char * argv[])
+{
+    const long tasks = arg_or(argc, argv, 1, 20000);
+    run("thread per call", tasks, [](auto func, Clock::time_point submitted)
+    {
+        return legacy_spawn_task(func, std::move(submitted));
+    });
+    run("shared executor", tasks, [](auto func, Clock::time_point submitted)
+    {
+        return spawn_task(func, submitted);
+    });
+    ThreadPool pool(4);
+    run("explicit 4-thread pool", tasks, [&pool](auto func, Clock::time_point submitted)
+    {
+        return spawn_task(pool, func, submitted);
+    });
+    return 0;
+}
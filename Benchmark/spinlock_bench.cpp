@@ -0,0 +1,114 @@
+// Lock throughput under contention: the previous test-and-set Spinlock, the
+// TTAS Spinlock with backoff, AdaptiveSpinlock (spin, then futex) and
+// std::mutex, with 2 to 64 threads hammering one short critical section.
+//   g++ -std=c++17 -O2 -pthread -I.. spinlock_bench.cpp -o spinlock_bench
+//   ./spinlock_bench [milliseconds per run]
+
+#include "../spinlock.hpp"
+#include "bench_util.hpp"
+
+#include <sys/resource.h>
+
+#include <cstdio>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+
+// Spinlock as it was: test_and_set in a tight loop.
+class TasSpinlock
+{
+public:
+    void lock()
+    {
+        while(flag.test_and_set(std::memory_order_acquire));
+    }
+
+    void unlock()
+    {
+        flag.clear(std::memory_order_release);
+    }
+
+private:
+    std::atomic_flag flag = ATOMIC_FLAG_INIT;
+};
+
+double cpu_seconds()
+{
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+struct Shared
+{
+    long counter = 0;
+    long checksum = 0;
+};
+
+template<typename Lock>
+void run(const char * name, unsigned threads, long millis)
+{
+    Lock lock;
+    Shared shared;
+    std::atomic<bool> go { false };
+    std::atomic<bool> stop { false };
+    std::vector<long> ops(threads);
+    std::vector<std::thread> workers;
+    for(unsigned tid = 0; tid < threads; ++tid)
+    {
+        workers.emplace_back([&, tid]()
+        {
+            while(!go.load(std::memory_order_acquire));
+            long local = 0;
+            while(!stop.load(std::memory_order_relaxed))
+            {
+                {
+                    std::lock_guard<Lock> lck(lock);
+                    ++shared.counter;
+                    shared.checksum += shared.counter;
+                }
+                ++local;
+            }
+            ops[tid] = local;
+        });
+    }
+
+    const double cpu_start = cpu_seconds();
+    Stopwatch sw;
+    go.store(true, std::memory_order_release);
+    std::this_thread::sleep_for(std::chrono::milliseconds(millis));
+    stop.store(true);
+    for(auto & thr : workers)
+    {
+        thr.join();
+    }
+    const double secs = sw.seconds();
+    const double cpu = cpu_seconds() - cpu_start;
+
+    long total = 0, least = ops[0];
+    for(long count : ops)
+    {
+        total += count;
+        least = std::min(least, count);
+    }
+    std::printf("%-18s %2u threads %9.2f Mops/s  slowest thread %5.1f%% of fair share  cpu %5.2f cores\n",
+        name, threads, total / secs / 1e6, 100.0 * least * threads / std::max(1L, total), cpu / secs);
+    do_not_optimize(shared.checksum);
+}
+
+} // namespace
+
+int main(int argc, char * argv[])
+{
+    const long millis = arg_or(argc, argv, 1, 200);
+    for(unsigned threads : { 2u, 4u, 8u, 16u, 32u, 64u })
+    {
+        run<TasSpinlock>("test-and-set", threads, millis);
+        run<Spinlock>("Spinlock (TTAS)", threads, millis);
+        run<AdaptiveSpinlock>("AdaptiveSpinlock", threads, millis);
+        run<std::mutex>("std::mutex", threads, millis);
+    }
+    return 0;
+}
@@ -0,0 +1,215 @@
+// One producer thread and one consumer thread moving n integers through:
+//  - SpscRingQueue with TryPush/TryGetFront and with 64-item batches,
+//  - BlockingSpscQueue with Push/GetFront and PushBatch/PopBatch,
+//  - MpmcRingQueue and BoundedBufferQueue with Push/GetFront.
+// The try-loops yield when the ring is full or empty. Also the cost of a
+// push and pop on a single thread, which is the bound when the two sides
+// never share a line.
+//   g++ -std=c++17 -O2 -pthread -I.. spsc_ring_queue_bench.cpp -o spsc_ring_queue_bench
+//   ./spsc_ring_queue_bench [items] [capacity]
+
+#include "../bounded_buffer_queue.h"
+#include "../mpmc_ring_queue.h"
+#include "../spsc_ring_queue.h"
+#include "bench_util.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+
+namespace
+{
+
+constexpr size_t kBatch = 64;
+
+void report(const char * name, long items, double secs)
+{
+    std::printf("%-34s %8.1f Mops/s\n", name, items / secs / 1e6);
+}
+
+template<typename Produce, typename Consume>
+double run(Produce produce, Consume consume)
+{
+    Stopwatch sw;
+    std::thread producer(produce);
+    consume();
+    producer.join();
+    return sw.seconds();
+}
+
+void spsc_single(long items, unsigned cap)
+{
+    SpscRingQueue<uint64_t> queue(cap);
+    uint64_t sum = 0;
+    const double secs = run([&]()
+    {
+        for(long ii = 0; ii < items; ++ii)
+        {
+            while(!queue.TryPush(static_cast<uint64_t>(ii)))
+            {
+                std::this_thread::yield();
+            }
+        }
+    },
+    [&]()
+    {
+        uint64_t val = 0;
+        for(long ii = 0; ii < items; ++ii)
+        {
+            while(!queue.TryGetFront(&val))
+            {
+                std::this_thread::yield();
+            }
+            sum += val;
+        }
+    });
+    do_not_optimize(sum);
+    report("SpscRingQueue try", items, secs);
+}
+
+void spsc_batch(long items, unsigned cap)
+{
+    SpscRingQueue<uint64_t> queue(cap);
+    uint64_t sum = 0;
+    const double secs = run([&]()
+    {
+        uint64_t buf[kBatch];
+        for(long ii = 0; ii < items; )
+        {
+            const size_t count = std::min<size_t>(kBatch, items - ii);
+            for(size_t idx = 0; idx < count; ++idx)
+            {
+                buf[idx] = ii + idx;
+            }
+            for(size_t done = 0; done < count; )
+            {
+                const size_t pushed = queue.TryPushBatch(buf + done, count - done);
+                if(pushed == 0)
+                {
+                    std::this_thread::yield();
+                }
+                done += pushed;
+            }
+            ii += count;
+        }
+    },
+    [&]()
+    {
+        uint64_t buf[kBatch];
+        for(long ii = 0; ii < items; )
+        {
+            const size_t popped = queue.TryPopBatch(buf, kBatch);
+            if(popped == 0)
+            {
+                std::this_thread::yield();
+            }
+            for(size_t idx = 0; idx < popped; ++idx)
+            {
+                sum += buf[idx];
+            }
+            ii += popped;
+        }
+    });
+    do_not_optimize(sum);
+    report("SpscRingQueue batch of 64", items, secs);
+}
+
+// Push/GetFront on any of the blocking queues.
+template<typename Queue>
+void blocking(const char * name, long items, unsigned cap)
+{
+    Queue queue(cap);
+    uint64_t sum = 0;
+    const double secs = run([&]()
+    {
+        for(long ii = 0; ii < items; ++ii)
+        {
+            queue.Push(static_cast<uint64_t>(ii));
+        }
+    },
+    [&]()
+    {
+        uint64_t val = 0;
+        for(long ii = 0; ii < items; ++ii)
+        {
+            queue.GetFront(&val);
+            sum += val;
+        }
+    });
+    do_not_optimize(sum);
+    report(name, items, secs);
+}
+
+void blocking_batch(long items, unsigned cap)
+{
+    BlockingSpscQueue<uint64_t> queue(cap);
+    uint64_t sum = 0;
+    const double secs = run([&]()
+    {
+        uint64_t buf[kBatch];
+        for(long ii = 0; ii < items; )
+        {
+            const size_t count = std::min<size_t>(kBatch, items - ii);
+            for(size_t idx = 0; idx < count; ++idx)
+            {
+                buf[idx] = ii + idx;
+            }
+            queue.PushBatch(buf, count);
+            ii += count;
+        }
+    },
+    [&]()
+    {
+        uint64_t buf[kBatch];
+        for(long ii = 0; ii < items; )
+        {
+            const size_t popped = queue.PopBatch(buf, kBatch);
+            for(size_t idx = 0; idx < popped; ++idx)
+            {
+                sum += buf[idx];
+            }
+            ii += popped;
+        }
+    });
+    do_not_optimize(sum);
+    report("BlockingSpscQueue batch of 64", items, secs);
+}
+
+void same_thread(long items)
+{
+    SpscRingQueue<uint64_t> queue(kBatch);
+    uint64_t val = 0;
+    uint64_t sum = 0;
+    Stopwatch sw;
+    for(long ii = 0; ii < items; ii += kBatch)
+    {
+        for(size_t idx = 0; idx < kBatch; ++idx)
+        {
+            queue.TryPush(ii + idx);
+        }
+        for(size_t idx = 0; idx < kBatch; ++idx)
+        {
+            queue.TryGetFront(&val);
+            sum += val;
+        }
+    }
+    do_not_optimize(sum);
+    report("SpscRingQueue one thread", items, sw.seconds());
+}
+
+} // namespace
+
+int main(int argc, char * argv[])
+{
+    const long items = arg_or(argc, argv, 1, 20000000);
+    const unsigned cap = static_cast<unsigned>(arg_or(argc, argv, 2, 4096));
+    same_thread(items);
+    spsc_single(items, cap);
+    spsc_batch(items, cap);
+    blocking<BlockingSpscQueue<uint64_t>>("BlockingSpscQueue Push/GetFront", items, cap);
+    blocking_batch(items, cap);
+    blocking<MpmcRingQueue<uint64_t>>("MpmcRingQueue Push/GetFront", items / 10, cap);
+    blocking<BoundedBufferQueue<uint64_t>>("BoundedBufferQueue Push/GetFront", items / 10, cap);
+    return 0;
+}
@@ -0,0 +1,64 @@
+// Cost of ThreadPool's built-in stats. Build it twice and compare ns/task:
+//   g++ -std=c++17 -O2 -pthread -I.. stats_bench.cpp -o stats_off
+//   g++ -std=c++17 -O2 -pthread -I.. -DTHREADPOOL_ENABLE_STATS stats_bench.cpp -o stats_on
+//   ./stats_off [tasks]; ./stats_on [tasks]
+
+#include "../threadpool.hpp"
+#include "bench_util.hpp"
+
+#include <cstdio>
+
+namespace
+{
+
+void print_stats(const ThreadPool::Stats & stats)
+{
+    const ThreadPool::WorkerStats total = stats.total();
+    std::printf("    %zu workers  %llu tasks  busy %.1f ms  idle %.1f ms\n", stats.workers.size(),
+        (unsigned long long)total.tasks, total.busy_ns / 1e6, total.idle_ns / 1e6);
+    std::printf("    queue wait p50 %.1f us  p99 %.1f us  run time p50 %llu ns  queue depth p50 %llu\n",
+        total.queue_wait.percentile(50) / 1e3, total.queue_wait.percentile(99) / 1e3,
+        (unsigned long long)total.run_time.percentile(50), (unsigned long long)total.queue_depth.percentile(50));
+}
+
+void run(const char * name, ThreadPool::SchedulePolicy policy, unsigned threads, long tasks)
+{
+    std::atomic<long> done { 0 };
+    Stopwatch watch;
+    {
+        ThreadPool pool(threads, policy);
+        for(long ii = 0; ii < tasks; ++ii)
+        {
+            pool.post([&done]() { done.fetch_add(1, std::memory_order_relaxed); });
+        }
+        while(done.load(std::memory_order_relaxed) < tasks)
+        {
+            std::this_thread::yield();
+        }
+        const double secs = watch.seconds();
+        std::printf("%-14s %2u threads  %7.1f ns/task\n", name, threads, secs * 1e9 / tasks);
+
+        Stopwatch scrape;
+        const ThreadPool::Stats stats = pool.stats();
+        const double scrape_us = scrape.seconds() * 1e6;
+        if(stats.enabled)
+        {
+            print_stats(stats);
+            std::printf("    stats() took %.1f us\n", scrape_us);
+        }
+    }
+}
+
+} // namespace
+
+int main(int argc, char * argv[])
+{
+    const long tasks = arg_or(argc, argv, 1, 1000000);
+    std::printf("stats %s\n", ThreadPool::stats_enabled() ? "enabled" : "disabled");
+    for(unsigned threads : { 1u, 4u })
+    {
+        run("shared queue", ThreadPool::SchedulePolicy::SHARED_QUEUE, threads, tasks);
+        run("work stealing", ThreadPool::SchedulePolicy::WORK_STEALING, threads, tasks);
+    }
+    return 0;
+}
@@ -0,0 +1,85 @@
+// Compares ThreadPool scheduling policies on millions of tiny tasks.
+//   g++ -std=c++17 -O2 -pthread -I.. threadpool_bench.cpp -o threadpool_bench
+//   ./threadpool_bench [tasks]
+
+#include "../threadpool.hpp"
+#include "bench_util.hpp"
+
+#include <atomic>
+#include <cstdio>
+
+namespace
+{
+
+const char * policy_name(ThreadPool::SchedulePolicy policy)
+{
+    return policy == ThreadPool::SchedulePolicy::SHARED_QUEUE ? "shared" : "stealing";
+}
+
+void wait_for(const std::atomic<long> & done, long target)
+{
+    while(done.load(std::memory_order_acquire) < target)
+    {
+        std::this_thread::yield();
+    }
+}
+
+// All tasks are submitted from the main thread.
+double run_external(unsigned threads, ThreadPool::SchedulePolicy policy, long tasks)
+{
+    std::atomic<long> done { 0 };
+    ThreadPool pool(threads, policy);
+    Stopwatch sw;
+    for(long ii = 0; ii < tasks; ++ii)
+    {
+        pool.execute([&done]() { done.fetch_add(1, std::memory_order_release); });
+    }
+    wait_for(done, tasks);
+    return sw.seconds();
+}
+
+// One root task per worker fans out into tiny children from inside the pool,
+// which is where per-worker deques pay off.
+double run_nested(unsigned threads, ThreadPool::SchedulePolicy policy, long tasks)
+{
+    std::atomic<long> done { 0 };
+    ThreadPool pool(threads, policy);
+    const long per_root = tasks / threads;
+    Stopwatch sw;
+    for(unsigned ii = 0; ii < threads; ++ii)
+    {
+        pool.execute([&pool, &done, per_root]()
+        {
+            for(long jj = 0; jj < per_root; ++jj)
+            {
+                pool.execute([&done]() { done.fetch_add(1, std::memory_order_release); });
+            }
+        });
+    }
+    wait_for(done, per_root * threads);
+    return sw.seconds();
+}
+
+} // namespace
+
+int main(int argc, char * argv[])
+{
+    const long tasks = arg_or(argc, argv, 1, 2000000);
+    const unsigned thread_counts[] = { 1, 4, 16, 64 };
+    const ThreadPool::SchedulePolicy policies[] = {
+        ThreadPool::SchedulePolicy::SHARED_QUEUE,
+        ThreadPool::SchedulePolicy::WORK_STEALING
+    };
+
+    std::printf("%-8s %-9s %14s %14s\n", "threads", "policy", "external Mt/s", "nested Mt/s");
+    for(unsigned threads : thread_counts)
+    {
+        for(auto policy : policies)
+        {
+            const double ext = run_external(threads, policy, tasks);
+            const double nested = run_nested(threads, policy, tasks);
+            std::printf("%-8u %-9s %14.2f %14.2f\n", threads, policy_name(policy),
+                tasks / ext / 1e6, tasks / nested / 1e6);
+        }
+    }
+}
@@ -0,0 +1,118 @@
+// CyclicBarrier and TreeBarrier: one callback per phase that sees every
+// thread's work, and a callback that throws in one phase, which must still
+// release the other threads and leave the barrier usable afterwards.
+//   g++ -std=c++17 -O2 -pthread -I.. barrier_test.cpp -o barrier_test
+
+#include "../cyclic_barrier.h"
+#include "../tree_barrier.h"
+#include "test_util.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+constexpr int kThreads = 6;
+constexpr int kPhases = 200;
+constexpr int kThrowingPhase = 37;
+
+struct Cyclic
+{
+    template<typename Func>
+    explicit Cyclic(Func on_phase) : barrier { kThreads, on_phase } {}
+    bool arrive_and_wait(int) { return barrier.ArriveAndWait(); }
+    uint32_t phase() const { return barrier.Phase(); }
+    CyclicBarrier barrier;
+};
+
+struct Tree
+{
+    // A fan-in of 2 gives the six threads a three-level tree.
+    template<typename Func>
+    explicit Tree(Func on_phase) : barrier { kThreads, on_phase, 2 } {}
+    bool arrive_and_wait(int id) { return barrier.ArriveAndWait(static_cast<unsigned>(id)); }
+    uint32_t phase() const { return barrier.Phase(); }
+    TreeBarrier barrier;
+};
+
+template<typename Barrier>
+void test_barrier(const char * name)
+{
+    std::atomic<int> work { 0 };
+    int completed = 0;
+    bool counts_ok = true;
+    Barrier barrier { [&]()
+    {
+        ++completed;
+        counts_ok = counts_ok && work.load(std::memory_order_relaxed) == completed * kThreads;
+        if(completed == kThrowingPhase)
+        {
+            throw std::runtime_error("on_phase");
+        }
+    } };
+
+    std::atomic<int> last_count { 0 };
+    std::atomic<int> thrown { 0 };
+    std::atomic<int> finished { 0 };
+    std::vector<std::thread> threads;
+    for(int tid = 0; tid < kThreads; ++tid)
+    {
+        threads.emplace_back([&, tid]()
+        {
+            for(int ii = 0; ii < kPhases; ++ii)
+            {
+                work.fetch_add(1, std::memory_order_relaxed);
+                try
+                {
+                    if(barrier.arrive_and_wait(tid))
+                    {
+                        ++last_count;
+                    }
+                }
+                catch(const std::runtime_error &)
+                {
+                    ++thrown;
+                }
+            }
+            ++finished;
+        });
+    }
+
+    // A barrier that does not release after the throw leaves the threads
+    // stuck, so check for that before joining them.
+    const auto give_up = std::chrono::steady_clock::now() + std::chrono::seconds(20);
+    while(finished < kThreads)
+    {
+        if(std::chrono::steady_clock::now() > give_up)
+        {
+            std::fprintf(stderr, "%s: ", name);
+            CHECK(false && "threads still waiting at the deadline");
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    for(auto & thr : threads)
+    {
+        thr.join();
+    }
+
+    CHECK(counts_ok);
+    CHECK(completed == kPhases);
+    CHECK(thrown == 1);
+    CHECK(last_count == kPhases - 1);
+    CHECK(barrier.phase() == static_cast<uint32_t>(kPhases));
+}
+
+} // namespace
+
+int main()
+{
+    test_barrier<Cyclic>("CyclicBarrier");
+    test_barrier<Tree>("TreeBarrier");
+    std::puts("barrier_test: ok");
+    return 0;
+}
@@ -0,0 +1,112 @@
+// BlockPool with threads allocating from different size classes at once
+// (they share the global pool) and freeing blocks on other threads than
+// the ones that allocated them. Run it under -fsanitize=thread.
+//   g++ -std=c++17 -O2 -pthread -I.. block_pool_test.cpp -o block_pool_test
+
+#include "../block_pool.hpp"
+#include "test_util.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace
+{
+
+constexpr size_t kSizes[] = { 24, 64, 100, 256, 1000 };
+
+// Each thread fills blocks of one size with its id and checks them, so two
+// threads handed the same block would notice.
+void test_size_classes()
+{
+    std::vector<std::thread> threads;
+    for(size_t tid = 0; tid < sizeof(kSizes) / sizeof(kSizes[0]); ++tid)
+    {
+        threads.emplace_back([tid]()
+        {
+            const size_t size = kSizes[tid];
+            std::vector<unsigned char *> blocks;
+            for(int round = 0; round < 20; ++round)
+            {
+                for(int ii = 0; ii < 200; ++ii)
+                {
+                    auto * block = static_cast<unsigned char *>(BlockPool::allocate(size));
+                    std::memset(block, static_cast<int>(tid), size);
+                    blocks.push_back(block);
+                }
+                for(auto * block : blocks)
+                {
+                    CHECK(block[0] == tid && block[size / 2] == tid && block[size - 1] == tid);
+                    BlockPool::deallocate(block, size);
+                }
+                blocks.clear();
+            }
+        });
+    }
+    for(auto & thr : threads)
+    {
+        thr.join();
+    }
+}
+
+// Producers allocate, consumers free.
+void test_cross_thread_free()
+{
+    constexpr int kPerProducer = 20000;
+    std::mutex mtx;
+    std::vector<std::pair<void *, size_t>> handoff;
+    std::atomic<int> freed { 0 };
+    std::vector<std::thread> threads;
+    for(int tid = 0; tid < 2; ++tid)
+    {
+        threads.emplace_back([&, tid]()
+        {
+            for(int ii = 0; ii < kPerProducer; ++ii)
+            {
+                const size_t size = kSizes[(ii + tid) % 4];
+                void * block = BlockPool::allocate(size);
+                std::lock_guard<std::mutex> lck(mtx);
+                handoff.emplace_back(block, size);
+            }
+        });
+        threads.emplace_back([&]()
+        {
+            while(freed.load() < 2 * kPerProducer)
+            {
+                std::vector<std::pair<void *, size_t>> batch;
+                {
+                    std::lock_guard<std::mutex> lck(mtx);
+                    batch.swap(handoff);
+                }
+                for(const auto & block : batch)
+                {
+                    BlockPool::deallocate(block.first, block.second);
+                }
+                freed += static_cast<int>(batch.size());
+                if(batch.empty())
+                {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for(auto & thr : threads)
+    {
+        thr.join();
+    }
+    CHECK(handoff.empty());
+}
+
+} // namespace
+
+int main()
+{
+    test_size_classes();
+    test_cross_thread_free();
+    std::puts("block_pool_test: ok");
+    return 0;
+}
@@ -0,0 +1,238 @@
+// CompactLock mutual exclusion, CompactOnceFlag, and CompactCondition with
+// notify_one()/notify_all() issued outside the lock, racing with threads
+// that are about to wait; once by holding the parking-lot bucket so that
+// both sides queue up on it, and once by brute force. A lost wakeup leaves
+// a waiter asleep for good, which the watchdog turns into a failed check
+// instead of a hang.
+//   g++ -std=c++17 -O2 -pthread -I.. compact_lock_test.cpp -o compact_lock_test
+
+#include "../compact_lock.hpp"
+#include "test_util.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+constexpr auto kDeadline = std::chrono::seconds(20);
+
+// Fails the test if finished has not been set by the deadline.
+class Watchdog
+{
+public:
+    explicit Watchdog(const char * name) :
+        name { name },
+        thr { [this]() { watch(); } }
+        {}
+
+    ~Watchdog()
+    {
+        finished = true;
+        thr.join();
+    }
+
+private:
+    void watch()
+    {
+        const auto give_up = std::chrono::steady_clock::now() + kDeadline;
+        while(!finished)
+        {
+            if(std::chrono::steady_clock::now() > give_up)
+            {
+                std::fprintf(stderr, "%s: ", name);
+                CHECK(false && "still running at the deadline");
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+
+    const char * name;
+    std::atomic<bool> finished { false };
+    std::thread thr;
+};
+
+void test_lock()
+{
+    CompactLock lock;
+    long counter = 0;
+    std::vector<std::thread> threads;
+    for(int tid = 0; tid < 4; ++tid)
+    {
+        threads.emplace_back([&]()
+        {
+            for(int ii = 0; ii < 50000; ++ii)
+            {
+                std::lock_guard<CompactLock> lck(lock);
+                ++counter;
+            }
+        });
+    }
+    for(auto & thr : threads)
+    {
+        thr.join();
+    }
+    CHECK(counter == 200000);
+    CHECK(lock.try_lock());
+    CHECK(!lock.try_lock());
+    lock.unlock();
+}
+
+void test_once()
+{
+    CompactOnceFlag flag;
+    std::atomic<int> calls { 0 };
+    CHECK_THROWS(flag.call_once([]() { throw std::runtime_error("first"); }), std::runtime_error);
+    CHECK(!flag.done());
+    std::vector<std::thread> threads;
+    for(int tid = 0; tid < 4; ++tid)
+    {
+        threads.emplace_back([&]() { flag.call_once([&]() { ++calls; }); });
+    }
+    for(auto & thr : threads)
+    {
+        thr.join();
+    }
+    CHECK(flag.done());
+    CHECK(calls.load() == 1);
+}
+
+// Producer hands out items one at a time and notifies after unlocking.
+void test_notify_one_outside_lock(unsigned consumers, long items)
+{
+    Watchdog watchdog("notify_one outside the lock");
+    CompactLock lock;
+    CompactCondition cond;
+    long queued = 0;
+    bool done = false;
+    std::atomic<long> consumed { 0 };
+    std::vector<std::thread> threads;
+    for(unsigned tid = 0; tid < consumers; ++tid)
+    {
+        threads.emplace_back([&]()
+        {
+            std::unique_lock<CompactLock> lck(lock);
+            for(;;)
+            {
+                cond.wait(lck, [&]() { return queued > 0 || done; });
+                if(queued == 0)
+                {
+                    return;
+                }
+                --queued;
+                ++consumed;
+            }
+        });
+    }
+    for(long ii = 0; ii < items; ++ii)
+    {
+        {
+            std::lock_guard<CompactLock> lck(lock);
+            ++queued;
+        }
+        cond.notify_one();
+    }
+    {
+        std::lock_guard<CompactLock> lck(lock);
+        done = true;
+    }
+    cond.notify_all();
+    for(auto & thr : threads)
+    {
+        thr.join();
+    }
+    CHECK(consumed.load() == items);
+}
+
+// Rounds of broadcast: every waiter must see every round, and the next
+// round starts as soon as all have, so waiters are often still on their
+// way into wait() when notify_all() runs.
+void test_notify_all_outside_lock(unsigned waiters, unsigned rounds)
+{
+    Watchdog watchdog("notify_all outside the lock");
+    std::mutex lock;
+    CompactCondition cond;
+    unsigned round = 0;
+    std::atomic<unsigned> seen { 0 };
+    std::vector<std::thread> threads;
+    for(unsigned tid = 0; tid < waiters; ++tid)
+    {
+        threads.emplace_back([&]()
+        {
+            for(unsigned expect = 1; expect <= rounds; ++expect)
+            {
+                std::unique_lock<std::mutex> lck(lock);
+                cond.wait(lck, [&]() { return round >= expect; });
+                lck.unlock();
+                ++seen;
+            }
+        });
+    }
+    for(unsigned next = 1; next <= rounds; ++next)
+    {
+        {
+            std::lock_guard<std::mutex> lck(lock);
+            round = next;
+        }
+        cond.notify_all();
+        while(seen.load() < next * waiters)
+        {
+            std::this_thread::yield();
+        }
+    }
+    for(auto & thr : threads)
+    {
+        thr.join();
+    }
+}
+
+// A waiter inside wait() and a notify_all() from outside the lock both get
+// stuck on the bucket lock, then race for it. Whichever wins, the waiter
+// must not end up parked with the waiter flag cleared, or the notify_all()
+// that really is for it returns without looking.
+void test_notify_racing_wait(int iterations)
+{
+    Watchdog watchdog("notify_all racing wait()");
+    for(int ii = 0; ii < iterations; ++ii)
+    {
+        std::mutex lock;
+        CompactCondition cond;
+        bool ready = false;
+        Spinlock & bucket = parking_lot::detail::bucket_for(&cond).lock;
+        bucket.lock();
+        std::thread waiter([&]()
+        {
+            std::unique_lock<std::mutex> lck(lock);
+            cond.wait(lck, [&]() { return ready; });
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        std::thread notifier([&]() { cond.notify_all(); });
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        bucket.unlock();
+        notifier.join();
+        {
+            std::lock_guard<std::mutex> lck(lock);
+            ready = true;
+        }
+        cond.notify_all();
+        waiter.join();
+    }
+}
+
+} // namespace
+
+int main()
+{
+    test_lock();
+    test_once();
+    test_notify_one_outside_lock(4, 200000);
+    test_notify_all_outside_lock(4, 20000);
+    test_notify_racing_wait(50);
+    std::puts("compact_lock_test: ok");
+    return 0;
+}
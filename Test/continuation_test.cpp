@@ -0,0 +1,161 @@
+// Future/Promise from continuation.hpp: then() chains on values and on
+// void, async_on(), exceptions travelling down a chain, broken promises,
+// and when_all()/when_any() with values, void, failures and empty input.
+//   g++ -std=c++17 -O2 -pthread -I.. continuation_test.cpp -o continuation_test
+
+#include "../continuation.hpp"
+#include "test_util.hpp"
+
+#include <cstdio>
+#include <future>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace
+{
+
+void test_then()
+{
+    ThreadPool pool(2);
+    Promise<int> promise;
+    auto fut = promise.get_future()
+        .then(pool, [](int val) { return val * 2; })
+        .then(pool, [](int val) { return std::to_string(val); });
+    // The chain is only posted once the value arrives.
+    CHECK(!fut.is_ready());
+    promise.set_value(21);
+    CHECK(fut.get() == "42");
+
+    int ran = 0;
+    CHECK(make_ready_future().then(pool, [&]() { ++ran; }).then(pool, [&]() { return ran; }).get() == 1);
+    CHECK(make_ready_future(5).then(pool, [](int val) { return val + 1; }).get() == 6);
+    CHECK(async_on(pool, [](int lhs, int rhs) { return lhs * rhs; }, 6, 7).get() == 42);
+    async_on(pool, [&]() { ++ran; }).get();
+    CHECK(ran == 2);
+}
+
+void test_exceptions()
+{
+    ThreadPool pool(2);
+    // A failed future skips the continuations after it.
+    bool skipped = true;
+    auto fut = async_on(pool, []() -> int { throw std::runtime_error("source"); })
+        .then(pool, [&](int val) { skipped = false; return val; });
+    CHECK_THROWS(fut.get(), std::runtime_error);
+    CHECK(skipped);
+
+    // A throwing continuation fails the future it returns.
+    auto thrown = make_ready_future(1).then(pool, [](int) -> int { throw std::logic_error("then"); })
+        .then(pool, [](int val) { return val; });
+    CHECK_THROWS(thrown.get(), std::logic_error);
+
+    // Dropping a promise fails its future, and the chain behind it.
+    Future<int> orphan;
+    {
+        Promise<int> promise;
+        orphan = promise.get_future();
+    }
+    CHECK(orphan.is_ready());
+    CHECK_THROWS(orphan.then(pool, [](int val) { return val; }).get(), std::future_error);
+
+    Promise<int> twice;
+    twice.set_value(1);
+    CHECK_THROWS(twice.set_value(2), std::future_error);
+}
+
+void test_when_all()
+{
+    ThreadPool pool(4);
+    std::vector<Promise<int>> promises(8);
+    std::vector<Future<int>> inputs;
+    for(auto & promise : promises)
+    {
+        inputs.push_back(promise.get_future());
+    }
+    auto all = when_all(std::move(inputs));
+    // Completed out of order; the values still come back in input order.
+    for(size_t ii = promises.size(); ii-- > 0; )
+    {
+        CHECK(!all.is_ready());
+        promises[ii].set_value(static_cast<int>(ii));
+    }
+    const std::vector<int> values = all.get();
+    CHECK(values.size() == 8);
+    for(size_t ii = 0; ii < values.size(); ++ii)
+    {
+        CHECK(values[ii] == static_cast<int>(ii));
+    }
+
+    std::vector<Future<void>> voids;
+    for(int ii = 0; ii < 100; ++ii)
+    {
+        voids.push_back(async_on(pool, []() {}));
+    }
+    when_all(std::move(voids)).get();
+
+    CHECK(when_all(std::vector<Future<int>>()).get().empty());
+    when_all(std::vector<Future<void>>()).get();
+
+    // One failure fails the whole set, without waiting for the rest.
+    Promise<int> pending;
+    std::vector<Future<int>> mixed;
+    mixed.push_back(pending.get_future());
+    mixed.push_back(async_on(pool, []() -> int { throw std::runtime_error("input"); }));
+    mixed.push_back(make_ready_future(3));
+    CHECK_THROWS(when_all(std::move(mixed)).get(), std::runtime_error);
+    pending.set_value(1);
+}
+
+void test_when_any()
+{
+    std::vector<Promise<std::string>> promises(4);
+    std::vector<Future<std::string>> inputs;
+    for(auto & promise : promises)
+    {
+        inputs.push_back(promise.get_future());
+    }
+    auto any = when_any(std::move(inputs));
+    CHECK(!any.is_ready());
+    promises[2].set_value("two");
+    promises[0].set_value("zero");
+    const std::pair<size_t, std::string> first = any.get();
+    CHECK(first.first == 2);
+    CHECK(first.second == "two");
+    promises[1].set_value("one");
+    promises[3].set_value("three");
+
+    Promise<void> late;
+    std::vector<Future<void>> voids;
+    voids.push_back(late.get_future());
+    voids.push_back(make_ready_future());
+    CHECK(when_any(std::move(voids)).get() == 1);
+    late.set_value();
+
+    // The first input to complete wins even if it failed.
+    Promise<int> slow;
+    Promise<int> failing;
+    std::vector<Future<int>> mixed;
+    mixed.push_back(slow.get_future());
+    mixed.push_back(failing.get_future());
+    auto race = when_any(std::move(mixed));
+    failing.set_exception(std::make_exception_ptr(std::runtime_error("input")));
+    slow.set_value(1);
+    CHECK_THROWS(race.get(), std::runtime_error);
+
+    CHECK_THROWS(when_any(std::vector<Future<int>>()), std::invalid_argument);
+    CHECK_THROWS(when_any(std::vector<Future<void>>()), std::invalid_argument);
+}
+
+} // namespace
+
+int main()
+{
+    test_then();
+    test_exceptions();
+    test_when_all();
+    test_when_any();
+    std::puts("continuation_test: ok");
+    return 0;
+}
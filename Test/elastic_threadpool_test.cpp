@@ -0,0 +1,136 @@
+// Elastic ThreadPool growth without outside help: a task that waits on
+// another queued task, without a BlockingScope, while nothing else is
+// submitted. The pool must notice the queued task has grown old and add a
+// worker, then shrink back once the extra worker has been idle for
+// idle_timeout.
+//   g++ -std=c++17 -O2 -pthread -I.. elastic_threadpool_test.cpp -o elastic_threadpool_test
+
+#include "../threadpool.hpp"
+#include "test_util.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <future>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+constexpr auto kDeadline = std::chrono::seconds(10);
+
+ThreadPool::ElasticOptions options(unsigned min_threads, unsigned max_threads)
+{
+    ThreadPool::ElasticOptions opts;
+    opts.min_threads = min_threads;
+    opts.max_threads = max_threads;
+    opts.grow_after = std::chrono::milliseconds(5);
+    opts.idle_timeout = std::chrono::milliseconds(50);
+    return opts;
+}
+
+// The only worker waits for a task it queued itself.
+void test_grows_for_waiting_task()
+{
+    ThreadPool pool(options(1, 4));
+    auto outer = pool.execute([&]()
+    {
+        auto inner = pool.execute([]() { return 7; });
+        return inner.get();
+    });
+    CHECK(outer.wait_for(kDeadline) == std::future_status::ready);
+    CHECK(outer.get() == 7);
+    CHECK(pool.size() >= 2);
+
+    // The extra worker retires once idle.
+    const auto give_up = std::chrono::steady_clock::now() + kDeadline;
+    while(pool.size() > 1 && std::chrono::steady_clock::now() < give_up)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    CHECK(pool.size() == 1);
+}
+
+// Every worker waits on a promise that only a queued task fulfils, and the
+// task was submitted from outside before the workers got stuck.
+void test_grows_when_all_workers_wait()
+{
+    const unsigned workers = 2;
+    ThreadPool pool(options(workers, 2 * workers));
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    std::vector<std::future<void>> stuck;
+    for(unsigned ii = 0; ii < workers; ++ii)
+    {
+        stuck.push_back(pool.execute([released]() { released.wait(); }));
+    }
+    auto releaser = pool.execute([&]() { release.set_value(); });
+    for(auto & fut : stuck)
+    {
+        CHECK(fut.wait_for(kDeadline) == std::future_status::ready);
+    }
+    CHECK(releaser.wait_for(kDeadline) == std::future_status::ready);
+}
+
+// A pool that sat at max_threads with work queued, where the supervisor
+// stops polling, still grows on its own once it has shrunk back.
+void test_grows_again_after_max()
+{
+    ThreadPool pool(options(1, 2));
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    std::vector<std::future<void>> stuck;
+    for(int ii = 0; ii < 4; ++ii)
+    {
+        stuck.push_back(pool.execute([released]() { released.wait(); }));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    CHECK(pool.size() == 2);
+    release.set_value();
+    for(auto & fut : stuck)
+    {
+        CHECK(fut.wait_for(kDeadline) == std::future_status::ready);
+    }
+
+    const auto give_up = std::chrono::steady_clock::now() + kDeadline;
+    while(pool.size() > 1 && std::chrono::steady_clock::now() < give_up)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    CHECK(pool.size() == 1);
+
+    auto outer = pool.execute([&]()
+    {
+        auto inner = pool.execute([]() { return 7; });
+        return inner.get();
+    });
+    CHECK(outer.wait_for(kDeadline) == std::future_status::ready);
+    CHECK(outer.get() == 7);
+}
+
+// No growth past max_threads, and a quiet pool keeps its size.
+void test_bounds()
+{
+    ThreadPool pool(options(2, 2));
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    CHECK(pool.size() == 2);
+    auto fut = pool.execute([]() { std::this_thread::sleep_for(std::chrono::milliseconds(20)); });
+    for(int ii = 0; ii < 4; ++ii)
+    {
+        pool.post([]() { std::this_thread::sleep_for(std::chrono::milliseconds(10)); });
+    }
+    fut.get();
+    CHECK(pool.size() == 2);
+}
+
+} // namespace
+
+int main()
+{
+    test_grows_for_waiting_task();
+    test_grows_when_all_workers_wait();
+    test_grows_again_after_max();
+    test_bounds();
+    std::puts("elastic_threadpool_test: ok");
+    return 0;
+}
@@ -0,0 +1,176 @@
+// CpuTopology::detect() on the real machine and on a fake sysfs tree whose
+// node ids have a hole, and a NumaThreadPool smoke test: one pool per node,
+// tasks run on a CPU of the node they were sent to. Also checks that the
+// COMPACT, SCATTER and EXPLICIT placements pin each worker to a CPU of
+// their order. Passes on single-node machines too.
+//   g++ -std=c++17 -O2 -pthread -I.. numa_threadpool_test.cpp -o numa_threadpool_test
+
+#include "../numa_threadpool.hpp"
+#include "../countdown_latch.h"
+#include "test_util.hpp"
+
+#include <sched.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+namespace fs = std::filesystem;
+
+bool contains(const std::vector<int> & ids, int id)
+{
+    return std::find(ids.begin(), ids.end(), id) != ids.end();
+}
+
+// A CPU the test may run on.
+int allowed_cpu()
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CHECK(sched_getaffinity(0, sizeof(set), &set) == 0);
+    for(int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+    {
+        if(CPU_ISSET(cpu, &set))
+        {
+            return cpu;
+        }
+    }
+    CHECK(false && "empty affinity mask");
+    return 0;
+}
+
+void write_file(const fs::path & path, const std::string & line)
+{
+    fs::create_directories(path.parent_path());
+    std::ofstream out(path);
+    out << line << '\n';
+}
+
+void test_parse_cpu_list()
+{
+    CHECK(CpuTopology::parse_cpu_list("0") == std::vector<int>({ 0 }));
+    CHECK(CpuTopology::parse_cpu_list("0-2,5,7-8") == std::vector<int>({ 0, 1, 2, 5, 7, 8 }));
+    CHECK(CpuTopology::parse_cpu_list("").empty());
+}
+
+// Nodes 0 and 2 are online and node 0 has memory but no CPUs: the one CPU
+// belongs to node 2, which counting up from node 0 would never reach.
+void test_node_hole()
+{
+    const int cpu = allowed_cpu();
+    const fs::path root = fs::temp_directory_path() / ("cpu_topology_test." + std::to_string(getpid()));
+    fs::remove_all(root);
+    write_file(root / "node/online", "0,2");
+    write_file(root / "node/node0/cpulist", "");
+    write_file(root / "node/node2/cpulist", std::to_string(cpu));
+    write_file(root / "cpu/online", std::to_string(cpu));
+    const fs::path topology = root / ("cpu/cpu" + std::to_string(cpu)) / "topology";
+    write_file(topology / "physical_package_id", "0");
+    write_file(topology / "core_id", "0");
+
+    const CpuTopology topo = CpuTopology::detect(root.string());
+    fs::remove_all(root);
+    CHECK(topo.cpus().size() == 1);
+    CHECK(topo.cpus()[0].id == cpu);
+    CHECK(topo.cpus()[0].node == 2);
+    CHECK(topo.nodes() == std::vector<int>({ 2 }));
+
+    NumaThreadPool pool(1, ThreadPool::SchedulePolicy::SHARED_QUEUE, topo);
+    CHECK(pool.nodes() == std::vector<int>({ 2 }));
+    CHECK(pool.execute_on(2, []() { return sched_getcpu(); }).get() == cpu);
+    CHECK(pool.execute_on(2, [&]() { return pool.current_node(); }).get() == 2);
+    CHECK_THROWS(pool.node_pool(0), std::out_of_range);
+    CHECK_THROWS(pool.execute_on(1, []() {}), std::out_of_range);
+}
+
+void test_detect()
+{
+    const CpuTopology topo = CpuTopology::detect();
+    CHECK(!topo.cpus().empty());
+    CHECK(!topo.nodes().empty());
+    size_t cpus = 0;
+    for(int node : topo.nodes())
+    {
+        cpus += topo.cpus_of_node(node).size();
+    }
+    CHECK(cpus == topo.cpus().size());
+    CHECK(topo.compact_order().size() == cpus);
+    CHECK(topo.scatter_order().size() == cpus);
+}
+
+void test_numa_pool()
+{
+    const CpuTopology topo = CpuTopology::detect();
+    for(unsigned threads_per_node : { 0u, 2u })
+    {
+        NumaThreadPool pool(threads_per_node);
+        CHECK(pool.nodes() == topo.nodes());
+        for(int node : pool.nodes())
+        {
+            const std::vector<int> cpus = topo.cpus_of_node(node);
+            for(int ii = 0; ii < 8; ++ii)
+            {
+                CHECK(contains(cpus, pool.execute_on(node, []() { return sched_getcpu(); }).get()));
+            }
+            CHECK(pool.execute_on(node, [&]() { return pool.current_node(); }).get() == node);
+
+            CountdownLatch done(4);
+            for(int ii = 0; ii < 4; ++ii)
+            {
+                pool.post_on(node, [&]() { done.Countdown(); });
+            }
+            done.Wait();
+        }
+        CHECK(contains(pool.nodes(), pool.execute([&]() { return pool.current_node(); }).get()));
+    }
+}
+
+// With one task per worker held until all have started, every worker
+// reports the CPU it was pinned to.
+void test_placement(ThreadPool::PlacementPolicy policy, const std::vector<int> & order)
+{
+    const unsigned threads = 2;
+    ThreadPool pool(threads, ThreadPool::SchedulePolicy::SHARED_QUEUE, ThreadPool::Placement(policy, order));
+    CountdownLatch started(threads);
+    std::vector<std::future<int>> cpus;
+    for(unsigned ii = 0; ii < threads; ++ii)
+    {
+        cpus.push_back(pool.execute([&]()
+        {
+            started.Countdown();
+            started.Wait();
+            return sched_getcpu();
+        }));
+    }
+    const std::vector<int> pinned(order.begin(), order.begin() + std::min<size_t>(threads, order.size()));
+    for(auto & cpu : cpus)
+    {
+        // A pool wider than the order wraps around it.
+        CHECK(contains(pinned, cpu.get()));
+    }
+}
+
+} // namespace
+
+int main()
+{
+    test_parse_cpu_list();
+    test_node_hole();
+    test_detect();
+    test_numa_pool();
+    const CpuTopology topo = CpuTopology::detect();
+    test_placement(ThreadPool::PlacementPolicy::COMPACT, topo.compact_order());
+    test_placement(ThreadPool::PlacementPolicy::SCATTER, topo.scatter_order());
+    test_placement(ThreadPool::PlacementPolicy::EXPLICIT, { allowed_cpu() });
+    std::puts("numa_threadpool_test: ok");
+    return 0;
+}
@@ -0,0 +1,99 @@
+// parallel_phases() must finish however many pool threads are free: with
+// more workers than threads, on a one-thread pool, and when called from a
+// pool task, where the calling worker is one of the pool's own threads.
+//   g++ -std=c++17 -O2 -pthread -I.. parallel_phases_test.cpp -o parallel_phases_test
+
+#include "../parallel_algorithm.hpp"
+#include "test_util.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+
+constexpr size_t kPhases = 5;
+
+// Every worker runs every phase exactly once, and in order.
+void run_phases(ThreadPool & pool, unsigned workers)
+{
+    std::vector<std::atomic<size_t>> done(workers);
+    std::atomic<size_t> out_of_order { 0 };
+    size_t betweens = 0;
+    parallel_phases(pool, workers, kPhases, [&](unsigned worker, size_t phase)
+    {
+        // Every worker has finished the previous phase.
+        for(auto & count : done)
+        {
+            if(count.load() < phase)
+            {
+                ++out_of_order;
+            }
+        }
+        if(done[worker].load() != phase)
+        {
+            ++out_of_order;
+        }
+        ++done[worker];
+    },
+    [&]() { ++betweens; });
+    for(auto & count : done)
+    {
+        CHECK(count.load() == kPhases);
+    }
+    CHECK(out_of_order.load() == 0);
+    CHECK(betweens >= kPhases - 1);
+}
+
+void test_more_workers_than_threads()
+{
+    for(unsigned threads : { 1u, 2u, 4u })
+    {
+        ThreadPool pool(threads);
+        for(unsigned workers : { 1u, 3u, 8u, 32u })
+        {
+            run_phases(pool, workers);
+        }
+    }
+}
+
+void test_from_pool_task()
+{
+    for(unsigned threads : { 1u, 4u })
+    {
+        ThreadPool pool(threads);
+        auto fut = pool.execute([&]() { run_phases(pool, 8); });
+        fut.get();
+    }
+}
+
+void test_exception_stops_loop()
+{
+    ThreadPool pool(4);
+    std::atomic<int> later { 0 };
+    CHECK_THROWS(parallel_phases(pool, 8, kPhases, [&](unsigned worker, size_t phase)
+    {
+        if(phase == 2 && worker == 7)
+        {
+            throw std::runtime_error("phase 2");
+        }
+        if(phase > 2)
+        {
+            ++later;
+        }
+    }), std::runtime_error);
+    CHECK(later.load() == 0);
+}
+
+} // namespace
+
+int main()
+{
+    test_more_workers_than_threads();
+    test_from_pool_task();
+    test_exception_stops_loop();
+    std::puts("parallel_phases_test: ok");
+    return 0;
+}
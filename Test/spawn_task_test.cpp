@@ -0,0 +1,117 @@
+// spawn_task() from inside spawned tasks: a parent that spawns a child and
+// waits for it must finish even when every worker of the executor is such a
+// parent, both with the wait inside a ThreadPool::BlockingScope (the pool
+// grows right away) and without one (the pool grows once the child has
+// queued for grow_after). Each wait is bounded, so a deadlock fails a check
+// instead of hanging. Also checks the result type for callables and
+// arguments that only work as rvalues.
+//   g++ -std=c++17 -O2 -pthread -I.. spawn_task_test.cpp -o spawn_task_test
+
+#include "../spawn_task.hpp"
+#include "test_util.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace
+{
+
+constexpr auto kDeadline = std::chrono::seconds(10);
+
+int child(int val)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    return val + 1;
+}
+
+int parent(ThreadPool & executor, int val, bool scoped)
+{
+    auto fut = spawn_task(executor, child, val);
+    if(scoped)
+    {
+        ThreadPool::BlockingScope blocking(executor);
+        return fut.get();
+    }
+    return fut.get();
+}
+
+// Twice as many parents as the pool starts with, so that they all end up
+// waiting at once; max_threads leaves room for their children.
+void test_nested(ThreadPool & executor, unsigned parents, bool scoped)
+{
+    std::vector<std::future<int>> futs;
+    for(unsigned ii = 0; ii < parents; ++ii)
+    {
+        futs.push_back(spawn_task(executor, parent, std::ref(executor), static_cast<int>(ii), scoped));
+    }
+    for(unsigned ii = 0; ii < parents; ++ii)
+    {
+        CHECK(futs[ii].wait_for(kDeadline) == std::future_status::ready);
+        CHECK(futs[ii].get() == static_cast<int>(ii) + 1);
+    }
+}
+
+void test_shared_executor()
+{
+    auto fut = spawn_task([]()
+    {
+        auto inner = spawn_task(child, 41);
+        return inner.get();
+    });
+    CHECK(fut.wait_for(kDeadline) == std::future_status::ready);
+    CHECK(fut.get() == 42);
+
+    const unsigned workers = std::max(1u, std::thread::hardware_concurrency());
+    test_nested(spawn_task_executor(), 2 * workers, true);
+    test_nested(spawn_task_executor(), 2 * workers, false);
+}
+
+void test_elastic_pool()
+{
+    ThreadPool::ElasticOptions options;
+    options.min_threads = 2;
+    options.max_threads = 8;
+    options.grow_after = std::chrono::milliseconds(5);
+    for(bool scoped : { true, false })
+    {
+        ThreadPool pool(options);
+        test_nested(pool, 4, scoped);
+    }
+}
+
+// Only callable as an rvalue, with an rvalue argument: the way spawn_task()
+// calls its copies.
+struct RvalueOnly
+{
+    int operator()(std::unique_ptr<int> && val) && { return *val; }
+};
+
+void test_result_type()
+{
+    ThreadPool pool(1);
+    RvalueOnly func;
+    auto val = std::make_unique<int>(7);
+    auto fut = spawn_task(pool, func, std::move(val));
+    static_assert(std::is_same<decltype(fut), std::future<int>>::value, "spawn_task returns a std::future");
+    CHECK(fut.get() == 7);
+
+    auto failed = spawn_task(pool, []() { throw std::runtime_error("task"); });
+    CHECK_THROWS(failed.get(), std::runtime_error);
+}
+
+} // namespace
+
+int main()
+{
+    test_shared_executor();
+    test_elastic_pool();
+    test_result_type();
+    std::puts("spawn_task_test: ok");
+    return 0;
+}
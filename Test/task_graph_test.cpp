@@ -0,0 +1,195 @@
+// TaskGraph: every task runs once and after all of its predecessors, on
+// chains, diamonds and wide fan-outs; a throwing task skips the tasks not
+// yet started and fails the run; cycles and bad ids are rejected; a graph
+// can be run twice and destroyed while its run is in progress.
+//   g++ -std=c++17 -O2 -pthread -I.. task_graph_test.cpp -o task_graph_test
+
+#include "../task_graph.hpp"
+#include "../countdown_latch.h"
+#include "test_util.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace
+{
+
+// Records the order in which tasks finish.
+struct Trace
+{
+    explicit Trace(size_t tasks) : finished(tasks) {}
+
+    void done(TaskGraph::TaskId id) { finished[id] = ++clock; }
+
+    std::atomic<size_t> clock { 0 };
+    std::vector<size_t> finished; // 0 until the task has run
+};
+
+// A random-ish layered DAG: every task depends on a few tasks of earlier
+// layers. Checks that each task ran once and after its predecessors.
+void test_dag(ThreadPool & pool)
+{
+    const size_t layers = 20;
+    const size_t width = 16;
+    TaskGraph graph;
+    Trace trace(layers * width);
+    std::vector<std::atomic<int>> runs(layers * width);
+    std::vector<std::pair<TaskGraph::TaskId, TaskGraph::TaskId>> edges;
+    for(size_t id = 0; id < layers * width; ++id)
+    {
+        CHECK(graph.add([&, id]() { ++runs[id]; trace.done(id); }) == id);
+    }
+    unsigned seed = 1;
+    for(size_t layer = 1; layer < layers; ++layer)
+    {
+        for(size_t col = 0; col < width; ++col)
+        {
+            const size_t after = layer * width + col;
+            for(int edge = 0; edge < 3; ++edge)
+            {
+                seed = seed * 1103515245 + 12345;
+                const size_t before = (seed >> 8) % (layer * width);
+                graph.precede(before, after);
+                edges.emplace_back(before, after);
+            }
+        }
+    }
+    CHECK(graph.size() == layers * width);
+    graph.run(pool).get();
+    for(auto & count : runs)
+    {
+        CHECK(count.load() == 1);
+    }
+    for(const auto & edge : edges)
+    {
+        CHECK(trace.finished[edge.first] < trace.finished[edge.second]);
+    }
+}
+
+void test_shapes(ThreadPool & pool)
+{
+    // A long chain runs in order.
+    {
+        TaskGraph graph;
+        std::vector<int> order;
+        for(int ii = 0; ii < 1000; ++ii)
+        {
+            graph.add([&, ii]() { order.push_back(ii); });
+            if(ii > 0)
+            {
+                graph.precede(ii - 1, ii);
+            }
+        }
+        graph.run(pool).get();
+        CHECK(order.size() == 1000);
+        for(int ii = 0; ii < 1000; ++ii)
+        {
+            CHECK(order[ii] == ii);
+        }
+    }
+    // Diamond with a wide middle: the sink sees every middle task.
+    {
+        TaskGraph graph;
+        std::atomic<int> middle { 0 };
+        int seen = -1;
+        const auto source = graph.add([]() {});
+        const auto sink = graph.add([&]() { seen = middle.load(); });
+        for(int ii = 0; ii < 200; ++ii)
+        {
+            const auto id = graph.add([&]() { ++middle; });
+            graph.precede(source, id);
+            graph.precede(id, sink);
+        }
+        graph.run(pool).get();
+        CHECK(seen == 200);
+    }
+    // Empty graph.
+    {
+        TaskGraph graph;
+        graph.run(pool).get();
+    }
+}
+
+void test_exception(ThreadPool & pool)
+{
+    TaskGraph graph;
+    std::atomic<int> after { 0 };
+    const auto first = graph.add([]() {});
+    const auto thrower = graph.add([]() { throw std::runtime_error("task"); });
+    graph.precede(first, thrower);
+    for(int ii = 0; ii < 10; ++ii)
+    {
+        graph.precede(thrower, graph.add([&]() { ++after; }));
+    }
+    CHECK_THROWS(graph.run(pool).get(), std::runtime_error);
+    CHECK(after.load() == 0);
+}
+
+void test_bad_graphs(ThreadPool & pool)
+{
+    TaskGraph graph;
+    const auto aa = graph.add([]() {});
+    const auto bb = graph.add([]() {});
+    const auto cc = graph.add([]() {});
+    CHECK_THROWS(graph.precede(aa, aa), std::invalid_argument);
+    CHECK_THROWS(graph.precede(aa, 3), std::invalid_argument);
+    graph.precede(aa, bb);
+    graph.precede(bb, cc);
+    graph.precede(cc, bb);
+    CHECK_THROWS(graph.run(pool), std::invalid_argument);
+
+    // A cycle that no task without predecessors leads into.
+    TaskGraph closed;
+    const auto xx = closed.add([]() {});
+    const auto yy = closed.add([]() {});
+    closed.precede(xx, yy);
+    closed.precede(yy, xx);
+    CHECK_THROWS(closed.run(pool), std::invalid_argument);
+}
+
+void test_rerun_and_destroy(ThreadPool & pool)
+{
+    std::atomic<int> runs { 0 };
+    CountdownLatch gate(1);
+    Future<void> done;
+    {
+        auto graph = std::make_unique<TaskGraph>();
+        const auto aa = graph->add([&]() { ++runs; });
+        const auto bb = graph->add([&]() { ++runs; });
+        graph->precede(aa, bb);
+        graph->run(pool).get();
+        graph->run(pool).get();
+        CHECK(runs.load() == 4);
+
+        const auto held = graph->add([&]() { gate.Wait(); });
+        graph->precede(bb, held);
+        done = graph->run(pool);
+    }
+    gate.Countdown();
+    done.get();
+    CHECK(runs.load() == 6);
+}
+
+} // namespace
+
+int main()
+{
+    for(auto policy : { ThreadPool::SchedulePolicy::SHARED_QUEUE, ThreadPool::SchedulePolicy::WORK_STEALING })
+    {
+        for(unsigned threads : { 1u, 4u })
+        {
+            ThreadPool pool(threads, policy);
+            test_dag(pool);
+            test_shapes(pool);
+            test_exception(pool);
+            test_bad_graphs(pool);
+            test_rerun_and_destroy(pool);
+        }
+    }
+    std::puts("task_graph_test: ok");
+    return 0;
+}
@@ -0,0 +1,28 @@
+#ifndef TEST_UTIL_HPP__
+#define TEST_UTIL_HPP__
+
+#include <cstdio>
+#include <cstdlib>
+
+// Like assert(), but also checked in builds with NDEBUG.
+#define CHECK(cond) \
+    do \
+    { \
+        if(!(cond)) \
+        { \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            std::abort(); \
+        } \
+    } while(0)
+
+// Expect expr to throw an exception of type Ex.
+#define CHECK_THROWS(expr, Ex) \
+    do \
+    { \
+        bool thrown_ = false; \
+        try { expr; } \
+        catch(const Ex &) { thrown_ = true; } \
+        CHECK(thrown_ && #expr " throws " #Ex); \
+    } while(0)
+
+#endif // TEST_UTIL_HPP__
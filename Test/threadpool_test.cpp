@@ -0,0 +1,107 @@
+// ThreadPool construction and submission basics: sizes that cannot work are
+// rejected up front under every schedule policy, in builds with NDEBUG too,
+// and execute_bulk()/post_batch() take a single-pass input range.
+//   g++ -std=c++17 -O2 -pthread -I.. threadpool_test.cpp -o threadpool_test
+
+#include "../threadpool.hpp"
+#include "test_util.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <iterator>
+#include <stdexcept>
+
+namespace
+{
+
+void test_rejects_bad_sizes()
+{
+    CHECK_THROWS(ThreadPool(0), std::invalid_argument);
+    CHECK_THROWS(ThreadPool(0, ThreadPool::SchedulePolicy::WORK_STEALING), std::invalid_argument);
+
+    ThreadPool::ElasticOptions opts;
+    opts.min_threads = 0;
+    opts.max_threads = 4;
+    CHECK_THROWS(ThreadPool { opts }, std::invalid_argument);
+    opts.min_threads = 3;
+    opts.max_threads = 2;
+    CHECK_THROWS(ThreadPool { opts }, std::invalid_argument);
+
+    ThreadPool pool(1, ThreadPool::SchedulePolicy::WORK_STEALING);
+    CHECK(pool.execute([]() { return 3; }).get() == 3);
+}
+
+// Input iterator over count jobs; all copies share one position, as with
+// std::istream_iterator, so walking the range once uses it up.
+class JobIterator
+{
+public:
+    struct Job
+    {
+        int operator()() const { ran->fetch_add(1); return value; }
+        int value;
+        std::atomic<int> * ran;
+    };
+
+    using iterator_category = std::input_iterator_tag;
+    using value_type = Job;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const Job *;
+    using reference = Job;
+
+    struct Source
+    {
+        int left;
+        std::atomic<int> ran { 0 };
+    };
+
+    JobIterator() : source { nullptr } {}
+    explicit JobIterator(Source & source) : source { &source } {}
+
+    Job operator*() const { return Job { source->left, &source->ran }; }
+    JobIterator & operator++() { --source->left; return *this; }
+    void operator++(int) { --source->left; }
+
+    bool operator==(const JobIterator & rhs) const { return at_end() == rhs.at_end(); }
+    bool operator!=(const JobIterator & rhs) const { return !(*this == rhs); }
+
+private:
+    bool at_end() const { return source == nullptr || source->left == 0; }
+
+    Source * source;
+};
+
+void test_single_pass_ranges(ThreadPool::SchedulePolicy policy)
+{
+    ThreadPool pool(2, policy);
+
+    JobIterator::Source source { 100 };
+    auto futs = pool.execute_bulk(JobIterator(source), JobIterator());
+    CHECK(futs.size() == 100);
+    int sum = 0;
+    for(auto & fut : futs)
+    {
+        sum += fut.get();
+    }
+    CHECK(sum == 100 * 101 / 2);
+    CHECK(source.ran == 100);
+
+    JobIterator::Source batch { 50 };
+    pool.post_batch(JobIterator(batch), JobIterator()).get();
+    CHECK(batch.ran == 50);
+
+    JobIterator::Source empty { 0 };
+    CHECK(pool.execute_bulk(JobIterator(empty), JobIterator()).empty());
+    pool.post_batch(JobIterator(empty), JobIterator()).get();
+}
+
+} // namespace
+
+int main()
+{
+    test_rejects_bad_sizes();
+    test_single_pass_ranges(ThreadPool::SchedulePolicy::SHARED_QUEUE);
+    test_single_pass_ranges(ThreadPool::SchedulePolicy::WORK_STEALING);
+    std::puts("threadpool_test: ok");
+    return 0;
+}
@@ -4,21 +4,24 @@
 #include <mutex>
 #include <memory>
 #include <algorithm>
+#include "../compact_lock.hpp"
 
+// Hand-over-hand locking: every node has its own lock, which is a one-byte
+// CompactLock so that it does not dominate the node's size.
 template<typename T>
 class ThreadsafeList
 {
 private:
     struct Node
     {
-        std::mutex mtx;
+        CompactLock mtx;
         std::shared_ptr<T> data;
         std::unique_ptr<Node> next;
 
         Node() = default;
 
-        Node(const T & val) : 
-            data { std::make_shared(val) }
+        Node(const T & val) :
+            data { std::make_shared<T>(val) }
             {}
     };
 
@@ -29,10 +32,21 @@ public:
 
     ThreadsafeList & operator=(const ThreadsafeList &) = delete;
 
+    // Unlinks nodes one at a time; letting the unique_ptr chain destroy
+    // itself would recurse once per node.
+    ~ThreadsafeList()
+    {
+        std::unique_ptr<Node> current = std::move(head.next);
+        while(current)
+        {
+            current = std::move(current->next);
+        }
+    }
+
     void push_front(const T & val)
     {
-        std::unique_ptr<Node> new_node = std::make_unique(val);
-        std::lock_guard<std::mutex> lck(head.mtx);
+        std::unique_ptr<Node> new_node = std::make_unique<Node>(val);
+        std::lock_guard<CompactLock> lck(head.mtx);
         new_node->next = std::move(head.next);
         head.next = std::move(new_node);
     }
@@ -41,10 +55,10 @@ public:
     void for_each(Func func)
     {
         Node * current = &head;
-        std::unique_lock<std::mutex> lck(head.mtx);
+        std::unique_lock<CompactLock> lck(head.mtx);
         while(Node * const next = current->next.get())
         {
-            std::unique_lock<std::mutex> next_lck(next->mtx);
+            std::unique_lock<CompactLock> next_lck(next->mtx);
             lck.unlock();
             func(*next->data);
             current = next;
@@ -56,10 +70,10 @@ public:
     std::shared_ptr<T> find_first_of(Predicate pred)
     {
         Node * current = &head;
-        std::unique_lock<std::mutex> lck(head.mtx);
+        std::unique_lock<CompactLock> lck(head.mtx);
         while(Node * const next = current->next.get())
         {
-            std::unique_lock<std::mutex> next_lck(next->mtx);
+            std::unique_lock<CompactLock> next_lck(next->mtx);
             lck.unlock();
             if(pred(*next->data))
             {
@@ -75,14 +89,15 @@ public:
     void remove_if(Predicate pred)
     {
         Node * current = &head;
-        std::unique_lock<std::mutex> lck(head.mtx);
+        std::unique_lock<CompactLock> lck(head.mtx);
         while(Node * const next = current->next.get())
         {
-            std::unique_lock<std::mutex> next_lck(next->mtx);
+            std::unique_lock<CompactLock> next_lck(next->mtx);
             if(pred(*next->data))
             {
-                std::unique_lock<Node> old_next = std::move(current->next);
+                std::unique_ptr<Node> old_next = std::move(current->next);
                 current->next = std::move(next->next);
+                // The node's lock must be free before the node goes away.
                 next_lck.unlock();
             }
             else
@@ -92,7 +107,6 @@ public:
                 lck = std::move(next_lck);
             }
         }
-        return std::shared_ptr<T>();
     }
 
 private:
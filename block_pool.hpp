@@ -0,0 +1,245 @@
+#ifndef BLOCK_POOL_HPP__
+#define BLOCK_POOL_HPP__
+
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <vector>
+#include "spinlock.hpp"
+
+// Size-class allocator for small, short-lived objects that are often freed on
+// a different thread than the one that allocated them (task closures, future
+// shared states).
+//
+// Each thread keeps a free list per size class. When it runs dry it takes a
+// whole batch of blocks from the global list, and when it grows too long it
+// hands a batch back, so the global spinlock is taken once per kBatch
+// operations at most. Memory is never returned to the system.
+class BlockPool
+{
+public:
+    static constexpr size_t kMaxBlockSize = 256;
+
+    static void * allocate(size_t size)
+    {
+        if(size > kMaxBlockSize)
+        {
+            return ::operator new(size);
+        }
+        const size_t cls = size_class(size);
+        if(cache_destroyed)
+        {
+            size_t got = 0;
+            return global().pop_batch(cls, 1, got);
+        }
+        ThreadCache & tc = cache();
+        if(tc.heads[cls] == nullptr)
+        {
+            tc.heads[cls] = global().pop_batch(cls, kBatch, tc.counts[cls]);
+        }
+        FreeBlock * block = tc.heads[cls];
+        tc.heads[cls] = block->next;
+        --tc.counts[cls];
+        return block;
+    }
+
+    static void deallocate(void * ptr, size_t size) noexcept
+    {
+        if(ptr == nullptr)
+        {
+            return;
+        }
+        if(size > kMaxBlockSize)
+        {
+            ::operator delete(ptr);
+            return;
+        }
+        const size_t cls = size_class(size);
+        FreeBlock * block = static_cast<FreeBlock *>(ptr);
+        if(cache_destroyed)
+        {
+            block->next = nullptr;
+            global().push_batch(cls, block, 1);
+            return;
+        }
+        ThreadCache & tc = cache();
+        block->next = tc.heads[cls];
+        tc.heads[cls] = block;
+        if(++tc.counts[cls] >= 2 * kBatch)
+        {
+            tc.release_batch(cls, kBatch);
+        }
+    }
+
+private:
+    static constexpr size_t kClassCount = 4; // 32, 64, 128 and 256 bytes
+    static constexpr size_t kBatch = 32;
+
+    struct FreeBlock
+    {
+        FreeBlock * next;       // next block in the same batch
+        FreeBlock * next_batch; // next batch on the global list
+        size_t batch_size;
+    };
+
+    static_assert(sizeof(FreeBlock) <= 32, "smallest size class must hold a FreeBlock");
+
+    static size_t size_class(size_t size)
+    {
+        size_t cls = 0;
+        for(size_t cap = 32; cap < size; cap <<= 1)
+        {
+            ++cls;
+        }
+        return cls;
+    }
+
+    static size_t class_size(size_t cls) { return size_t(32) << cls; }
+
+    class Global
+    {
+    public:
+        Global() : batches {} {}
+
+        // Returns a null-terminated chain of at most n blocks and stores its
+        // length in got.
+        FreeBlock * pop_batch(size_t cls, size_t n, size_t & got)
+        {
+            std::lock_guard<Spinlock> lck(locks[cls]);
+            FreeBlock * head = batches[cls];
+            if(head != nullptr && head->batch_size <= n)
+            {
+                batches[cls] = head->next_batch;
+                got = head->batch_size;
+                return head;
+            }
+            if(head != nullptr && head->batch_size > n)
+            {
+                // Split a batch: hand out the first n blocks, keep the rest.
+                FreeBlock * tail = head;
+                for(size_t ii = 1; ii < n; ++ii)
+                {
+                    tail = tail->next;
+                }
+                FreeBlock * rest = tail->next;
+                tail->next = nullptr;
+                rest->next_batch = head->next_batch;
+                rest->batch_size = head->batch_size - n;
+                batches[cls] = rest;
+                got = n;
+                return head;
+            }
+            got = n;
+            return carve(cls, n);
+        }
+
+        void push_batch(size_t cls, FreeBlock * head, size_t n)
+        {
+            head->batch_size = n;
+            std::lock_guard<Spinlock> lck(locks[cls]);
+            head->next_batch = batches[cls];
+            batches[cls] = head;
+        }
+
+    private:
+        // Caller holds locks[cls].
+        FreeBlock * carve(size_t cls, size_t n)
+        {
+            const size_t bytes = class_size(cls);
+            char * slab = static_cast<char *>(::operator new(bytes * n));
+            slabs[cls].push_back(slab);
+            for(size_t ii = 0; ii + 1 < n; ++ii)
+            {
+                reinterpret_cast<FreeBlock *>(slab + ii * bytes)->next =
+                    reinterpret_cast<FreeBlock *>(slab + (ii + 1) * bytes);
+            }
+            reinterpret_cast<FreeBlock *>(slab + (n - 1) * bytes)->next = nullptr;
+            return reinterpret_cast<FreeBlock *>(slab);
+        }
+
+        // Everything of a size class is guarded by its lock, slabs included.
+        Spinlock locks[kClassCount];
+        FreeBlock * batches[kClassCount];
+        std::vector<char *> slabs[kClassCount];
+    };
+
+    struct ThreadCache
+    {
+        FreeBlock * heads[kClassCount] = {};
+        size_t counts[kClassCount] = {};
+
+        void release_batch(size_t cls, size_t n)
+        {
+            FreeBlock * head = heads[cls];
+            FreeBlock * tail = head;
+            for(size_t ii = 1; ii < n; ++ii)
+            {
+                tail = tail->next;
+            }
+            heads[cls] = tail->next;
+            tail->next = nullptr;
+            counts[cls] -= n;
+            global().push_batch(cls, head, n);
+        }
+
+        ~ThreadCache()
+        {
+            for(size_t cls = 0; cls < kClassCount; ++cls)
+            {
+                if(counts[cls] > 0)
+                {
+                    release_batch(cls, counts[cls]);
+                }
+            }
+            cache_destroyed = true;
+        }
+    };
+
+    // Leaked on purpose: thread caches flush into it during thread and
+    // process exit, after function-local statics may have been destroyed.
+    static Global & global()
+    {
+        static Global * instance = new Global();
+        return *instance;
+    }
+
+    static ThreadCache & cache()
+    {
+        thread_local ThreadCache tc;
+        return tc;
+    }
+
+    inline static thread_local bool cache_destroyed = false;
+};
+
+// Standard allocator backed by BlockPool, e.g. for the shared state of a
+// std::promise constructed with std::allocator_arg.
+template<typename T>
+struct PoolAllocator
+{
+    using value_type = T;
+
+    PoolAllocator() noexcept = default;
+
+    template<typename U>
+    PoolAllocator(const PoolAllocator<U> &) noexcept {}
+
+    T * allocate(size_t n)
+    {
+        static_assert(alignof(T) <= alignof(std::max_align_t), "over-aligned type");
+        return static_cast<T *>(BlockPool::allocate(n * sizeof(T)));
+    }
+
+    void deallocate(T * ptr, size_t n) noexcept
+    {
+        BlockPool::deallocate(ptr, n * sizeof(T));
+    }
+
+    template<typename U>
+    bool operator==(const PoolAllocator<U> &) const noexcept { return true; }
+
+    template<typename U>
+    bool operator!=(const PoolAllocator<U> &) const noexcept { return false; }
+};
+
+#endif // BLOCK_POOL_HPP__
@@ -1,10 +1,13 @@
 #ifndef _BOUNDED_BUFFER_QUEUE_H_
 #define _BOUNDED_BUFFER_QUEUE_H_
 
+#include <algorithm>
 #include <atomic>
 #include <condition_variable>
+#include <cstddef>
 #include <mutex>
 #include <queue>
+#include <utility>
 
 template<typename T>
 class BoundedBufferQueue {
@@ -25,14 +28,37 @@ public:
 		++get_counter_;
 		std::unique_lock<std::mutex> lck(mtx_);
 		cv1_.wait(lck, [&]() { return stop_ || !queue_.empty(); });
+		--get_counter_;
 		if (stop_) {
 			return;
 		}
-		*val = queue_.front(); queue_.pop();
-		--get_counter_;
+		*val = std::move(queue_.front()); queue_.pop();
 		cv2_.notify_one();
 	}
 
+	// Waits for at least one element, then moves up to max_count of them to
+	// out under the same lock, with one wakeup for the producers. Returns
+	// how many, 0 once the queue is being destroyed.
+	template<typename OutputIt>
+	size_t PopBatch(OutputIt out, size_t max_count) {
+		if (max_count == 0) {
+			return 0;
+		}
+		++get_counter_;
+		std::unique_lock<std::mutex> lck(mtx_);
+		cv1_.wait(lck, [&]() { return stop_ || !queue_.empty(); });
+		--get_counter_;
+		if (stop_) {
+			return 0;
+		}
+		const size_t count = std::min(max_count, queue_.size());
+		for (size_t idx = 0; idx < count; ++idx, ++out) {
+			*out = std::move(queue_.front()); queue_.pop();
+		}
+		Wake(cv2_, count);
+		return count;
+	}
+
   bool IsEmpty() const {
     std::lock_guard<std::mutex> lck(mtx_);
     return queue_.empty();
@@ -44,25 +70,67 @@ public:
   }
 
 	void Push(T val) {
+		Emplace(std::move(val));
+	}
+
+	template<typename... Args>
+	void Emplace(Args&&... args) {
 		++push_counter_;
 		std::unique_lock<std::mutex> lck(mtx_);
 		cv2_.wait(lck, [&]() { return stop_ || queue_.size() < cap_; });
+		--push_counter_;
 		if (stop_) {
 			return;
 		}
-		queue_.push(val);
-		--push_counter_;
+		queue_.emplace(std::forward<Args>(args)...);
 		cv1_.notify_one();
 	}
 
+	// Moves count elements from first into the queue. Each time the lock is
+	// taken, as many as fit go in and the consumers get one wakeup; so the
+	// batch only takes more than one round trip when the queue fills up.
+	// The rest is dropped once the queue is being destroyed.
+	template<typename InputIt>
+	void PushBatch(InputIt first, size_t count) {
+		while (count != 0) {
+			++push_counter_;
+			std::unique_lock<std::mutex> lck(mtx_);
+			cv2_.wait(lck, [&]() { return stop_ || queue_.size() < cap_; });
+			--push_counter_;
+			if (stop_) {
+				return;
+			}
+			const size_t pushed = std::min<size_t>(count, cap_ - queue_.size());
+			for (size_t idx = 0; idx < pushed; ++idx, ++first) {
+				queue_.push(std::move(*first));
+			}
+			count -= pushed;
+			Wake(cv1_, pushed);
+		}
+	}
+
 	~BoundedBufferQueue() noexcept {
-		stop_ = true;
+		{
+			std::lock_guard<std::mutex> lck(mtx_);
+			stop_ = true;
+		}
 		cv1_.notify_all();
 		cv2_.notify_all();
 		while (get_counter_ > 0 || push_counter_ > 0);
+		// The last of them may still be releasing the mutex.
+		std::lock_guard<std::mutex> lck(mtx_);
 	}
 
 private:
+	// One element is for one waiter; more may keep several busy.
+	static void Wake(std::condition_variable& cv, size_t count) {
+		if (count == 1) {
+			cv.notify_one();
+		} else if (count > 1) {
+			cv.notify_all();
+		}
+	}
+
 	unsigned cap_;
 	bool stop_;
 	mutable std::mutex mtx_;
@@ -0,0 +1,266 @@
+#ifndef COMPACT_LOCK_HPP__
+#define COMPACT_LOCK_HPP__
+
+#include <atomic>
+#include <cstdint>
+#include "cpu_relax.hpp"
+#include "parking_lot.hpp"
+
+// One-byte synchronization primitives that keep their waiters in the
+// global parking lot (parking_lot.hpp) instead of in the object. Meant for
+// data structures with a lock per element, where a 40-byte std::mutex per
+// element adds up.
+
+// Mutex with a spin phase. Bit LOCKED is the lock itself; PARKED says a
+// thread may be parked on it, so unlock() has to go to the parking lot.
+// unlock() does not hand the lock over: the woken thread competes for it
+// again, which keeps the lock fast under contention (barging) but not fair.
+class CompactLock
+{
+public:
+    CompactLock() :
+        bits { 0 }
+        {}
+
+    CompactLock(const CompactLock &) = delete;
+
+    CompactLock & operator=(const CompactLock &) = delete;
+
+    void lock()
+    {
+        uint8_t expected = 0;
+        if(!bits.compare_exchange_weak(expected, LOCKED, std::memory_order_acquire, std::memory_order_relaxed))
+        {
+            lock_slow();
+        }
+    }
+
+    bool try_lock()
+    {
+        uint8_t state = bits.load(std::memory_order_relaxed);
+        while(!(state & LOCKED))
+        {
+            if(bits.compare_exchange_weak(state, state | LOCKED, std::memory_order_acquire, std::memory_order_relaxed))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void unlock()
+    {
+        uint8_t expected = LOCKED;
+        if(!bits.compare_exchange_strong(expected, 0, std::memory_order_release, std::memory_order_relaxed))
+        {
+            unlock_slow();
+        }
+    }
+
+private:
+    static constexpr uint8_t LOCKED = 1;
+    static constexpr uint8_t PARKED = 2;
+
+    void lock_slow()
+    {
+        SpinBackoff backoff;
+        for(;;)
+        {
+            uint8_t state = bits.load(std::memory_order_relaxed);
+            if(!(state & LOCKED))
+            {
+                if(bits.compare_exchange_weak(state, state | LOCKED, std::memory_order_acquire, std::memory_order_relaxed))
+                {
+                    return;
+                }
+                continue;
+            }
+            // Spin while nobody is parked yet; once someone is, spinning
+            // would only delay joining the queue.
+            if(!(state & PARKED) && !backoff.spun_out())
+            {
+                backoff.pause();
+                continue;
+            }
+            if(!(state & PARKED) &&
+                !bits.compare_exchange_weak(state, state | PARKED, std::memory_order_relaxed, std::memory_order_relaxed))
+            {
+                continue;
+            }
+            parking_lot::park(&bits, [this]()
+            {
+                return bits.load(std::memory_order_relaxed) == (LOCKED | PARKED);
+            });
+        }
+    }
+
+    void unlock_slow()
+    {
+        // PARKED is set. Clearing LOCKED happens under the bucket lock, so a
+        // thread about to park either sees it or gets woken.
+        parking_lot::unpark_one(&bits, [this](parking_lot::UnparkResult result)
+        {
+            bits.store(result.have_more ? PARKED : 0, std::memory_order_release);
+        });
+    }
+
+    std::atomic<uint8_t> bits;
+};
+
+// Condition variable for any lock with lock()/unlock(), such as CompactLock
+// or std::unique_lock. The byte only records whether anyone may be waiting,
+// so notify_*() with no waiters stays out of the parking lot. It is set and
+// cleared only under the bucket lock, together with queueing and dequeueing
+// waiters, so it is never 0 while a thread is parked; a notify racing with a
+// waiter that has not queued yet cannot clear it behind that waiter's back.
+class CompactCondition
+{
+public:
+    CompactCondition() :
+        has_waiters { 0 }
+        {}
+
+    CompactCondition(const CompactCondition &) = delete;
+
+    CompactCondition & operator=(const CompactCondition &) = delete;
+
+    // The waiter is queued before lock is released, so a notify issued
+    // after taking the lock cannot be missed. May wake spuriously.
+    template<typename Lock>
+    void wait(Lock & lock)
+    {
+        parking_lot::park(&has_waiters, [this]()
+        {
+            has_waiters.store(1, std::memory_order_relaxed);
+            return true;
+        },
+        [&lock]() { lock.unlock(); });
+        lock.lock();
+    }
+
+    template<typename Lock, typename Predicate>
+    void wait(Lock & lock, Predicate pred)
+    {
+        while(!pred())
+        {
+            wait(lock);
+        }
+    }
+
+    void notify_one()
+    {
+        if(!has_waiters.load(std::memory_order_relaxed))
+        {
+            return;
+        }
+        parking_lot::unpark_one(&has_waiters, [this](parking_lot::UnparkResult result)
+        {
+            if(!result.have_more)
+            {
+                has_waiters.store(0, std::memory_order_relaxed);
+            }
+        });
+    }
+
+    void notify_all()
+    {
+        if(!has_waiters.load(std::memory_order_relaxed))
+        {
+            return;
+        }
+        parking_lot::unpark_all(&has_waiters, [this](size_t)
+        {
+            has_waiters.store(0, std::memory_order_relaxed);
+        });
+    }
+
+private:
+    std::atomic<uint8_t> has_waiters;
+};
+
+// std::call_once in one byte. Threads that find the call running park
+// until it finishes. If func throws, the flag is reset, one of the waiters
+// (or a later caller) tries again, and the exception propagates.
+class CompactOnceFlag
+{
+public:
+    CompactOnceFlag() :
+        state { INIT }
+        {}
+
+    CompactOnceFlag(const CompactOnceFlag &) = delete;
+
+    CompactOnceFlag & operator=(const CompactOnceFlag &) = delete;
+
+    template<typename Func>
+    void call_once(Func && func)
+    {
+        if(state.load(std::memory_order_acquire) != DONE)
+        {
+            call_slow(func);
+        }
+    }
+
+    bool done() const { return state.load(std::memory_order_acquire) == DONE; }
+
+private:
+    static constexpr uint8_t INIT = 0;
+    static constexpr uint8_t RUNNING = 1;
+    static constexpr uint8_t PARKED = 2;
+    static constexpr uint8_t DONE = 4;
+
+    template<typename Func>
+    void call_slow(Func & func)
+    {
+        for(;;)
+        {
+            uint8_t current = state.load(std::memory_order_acquire);
+            if(current == DONE)
+            {
+                return;
+            }
+            if(current == INIT)
+            {
+                if(!state.compare_exchange_weak(current, RUNNING, std::memory_order_acquire, std::memory_order_relaxed))
+                {
+                    continue;
+                }
+                try
+                {
+                    func();
+                }
+                catch(...)
+                {
+                    finish(INIT);
+                    throw;
+                }
+                finish(DONE);
+                return;
+            }
+            if(!(current & PARKED) &&
+                !state.compare_exchange_weak(current, current | PARKED, std::memory_order_relaxed, std::memory_order_relaxed))
+            {
+                continue;
+            }
+            parking_lot::park(&state, [this]()
+            {
+                return state.load(std::memory_order_relaxed) == (RUNNING | PARKED);
+            });
+        }
+    }
+
+    void finish(uint8_t next)
+    {
+        if(state.exchange(next, std::memory_order_release) & PARKED)
+        {
+            parking_lot::unpark_all(&state);
+        }
+    }
+
+    std::atomic<uint8_t> state;
+};
+
+static_assert(sizeof(CompactLock) == 1 && sizeof(CompactCondition) == 1 && sizeof(CompactOnceFlag) == 1,
+    "compact primitives must stay one byte");
+
+#endif // COMPACT_LOCK_HPP__
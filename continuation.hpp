@@ -0,0 +1,368 @@
+#ifndef CONTINUATION_HPP__
+#define CONTINUATION_HPP__
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "function_wrapper.hpp"
+#include "threadpool.hpp"
+
+// Future/Promise pair whose results can be chained without blocking a
+// thread: then() schedules a continuation on a ThreadPool as soon as the
+// value is ready, and when_all()/when_any() combine futures the same way.
+// A Future has a single consumer: get(), then(), when_all() and when_any()
+// each consume it.
+
+template <typename T> class Future;
+template <typename T> class Promise;
+
+namespace continuation_detail {
+
+struct Unit {};
+
+template <typename T>
+using Stored = std::conditional_t<std::is_void<T>::value, Unit, T>;
+
+template <typename T>
+class SharedState {
+public:
+    using Callback = FunctionWrapper;
+
+    void set_value(Stored<T> val) { complete([&]() { value.emplace(std::move(val)); }); }
+
+    void set_exception(std::exception_ptr err) { complete([&]() { error = std::move(err); }); }
+
+    // Runs cb once the state is ready: right away on the calling thread if it
+    // already is, otherwise on the thread that completes it.
+    void on_ready(Callback cb) {
+        {
+            std::lock_guard<std::mutex> lck(mtx);
+            if(!ready) {
+                callbacks.push_back(std::move(cb));
+                return;
+            }
+        }
+        cb();
+    }
+
+    bool is_ready() const {
+        std::lock_guard<std::mutex> lck(mtx);
+        return ready;
+    }
+
+    void wait() const {
+        std::unique_lock<std::mutex> lck(mtx);
+        cv.wait(lck, [&]() { return ready; });
+    }
+
+    // Valid once ready.
+    const std::exception_ptr& exception() const { return error; }
+
+    Stored<T> take() {
+        if(error) { std::rethrow_exception(error); }
+        return std::move(*value);
+    }
+
+private:
+    template <typename Set>
+    void complete(Set set) {
+        std::vector<Callback> run;
+        {
+            std::lock_guard<std::mutex> lck(mtx);
+            if(ready) { throw std::future_error(std::future_errc::promise_already_satisfied); }
+            set();
+            ready = true;
+            run.swap(callbacks);
+        }
+        cv.notify_all();
+        for(auto& cb : run) { cb(); }
+    }
+
+    mutable std::mutex mtx;
+    mutable std::condition_variable cv;
+    bool ready = false;
+    std::optional<Stored<T>> value;
+    std::exception_ptr error;
+    std::vector<Callback> callbacks;
+};
+
+template <typename T>
+using StatePtr = std::shared_ptr<SharedState<T>>;
+
+template <typename Func, typename T>
+struct ResultOf { using type = std::invoke_result_t<Func&, T>; };
+
+template <typename Func>
+struct ResultOf<Func, void> { using type = std::invoke_result_t<Func&>; };
+
+struct Access {
+    template <typename T>
+    static StatePtr<T>& state(Future<T>& fut) { return fut.state; }
+
+    template <typename T>
+    static StatePtr<T>& state(Promise<T>& promise) { return promise.state; }
+};
+
+// Runs call() and stores its result (or exception) in promise.
+template <typename R, typename Call>
+void fulfill(Promise<R>& promise, Call& call) {
+    try {
+        if constexpr (std::is_void<R>::value) {
+            call();
+            promise.set_value();
+        } else {
+            promise.set_value(call());
+        }
+    } catch(...) {
+        promise.set_exception(std::current_exception());
+    }
+}
+
+// Feeds the ready value of src into func and stores the outcome in next. An
+// exception in src skips func and is forwarded.
+template <typename T, typename R, typename Func>
+void chain(SharedState<T>& src, Func& func, Promise<R>& next) {
+    if(src.exception()) {
+        next.set_exception(src.exception());
+        return;
+    }
+    if constexpr (std::is_void<T>::value) {
+        fulfill(next, func);
+    } else {
+        auto call = [&]() -> decltype(auto) { return func(src.take()); };
+        fulfill(next, call);
+    }
+}
+
+} // namespace continuation_detail
+
+template <typename T>
+class Future {
+public:
+    Future() = default;
+
+    Future(Future&&) = default;
+
+    Future& operator=(Future&&) = default;
+
+    Future(const Future&) = delete;
+
+    Future& operator=(const Future&) = delete;
+
+    bool valid() const { return state != nullptr; }
+
+    bool is_ready() const { return state->is_ready(); }
+
+    // Blocks. Meant for threads outside the pool; pool tasks should use then().
+    void wait() const { state->wait(); }
+
+    T get() {
+        auto src = std::move(state);
+        src->wait();
+        if constexpr (std::is_void<T>::value) {
+            src->take();
+        } else {
+            return src->take();
+        }
+    }
+
+    // Posts func(value) to pool once this future is ready and returns a future
+    // for its result. func takes no argument for Future<void>.
+    template <typename Func>
+    auto then(ThreadPool& pool, Func func) {
+        using R = typename continuation_detail::ResultOf<Func, T>::type;
+        Promise<R> next;
+        Future<R> result = next.get_future();
+        auto src = std::move(state);
+        auto& ready = *src;
+        // The callback holding src lives in src until src completes, which
+        // always happens: an abandoned Promise completes with broken_promise.
+        ready.on_ready([&pool, src = std::move(src), func = std::move(func), next = std::move(next)]() mutable {
+            pool.post([src = std::move(src), func = std::move(func), next = std::move(next)]() mutable {
+                continuation_detail::chain(*src, func, next);
+            });
+        });
+        return result;
+    }
+
+private:
+    friend struct continuation_detail::Access;
+    friend class Promise<T>;
+
+    explicit Future(continuation_detail::StatePtr<T> state) :
+        state { std::move(state) } {}
+
+    continuation_detail::StatePtr<T> state;
+};
+
+template <typename T>
+class Promise {
+public:
+    Promise() :
+        state { std::make_shared<continuation_detail::SharedState<T>>() } {}
+
+    Promise(Promise&& rhs) noexcept :
+        state { std::move(rhs.state) },
+        satisfied { rhs.satisfied } {}
+
+    Promise& operator=(Promise&&) = delete;
+
+    Promise(const Promise&) = delete;
+
+    Promise& operator=(const Promise&) = delete;
+
+    ~Promise() noexcept {
+        if(state && !satisfied) {
+            state->set_exception(std::make_exception_ptr(std::future_error(std::future_errc::broken_promise)));
+        }
+    }
+
+    Future<T> get_future() { return Future<T>(state); }
+
+    template <typename U = T, typename = std::enable_if_t<std::is_void<U>::value>>
+    void set_value() {
+        satisfied = true;
+        state->set_value(continuation_detail::Unit());
+    }
+
+    template <typename U = T, typename = std::enable_if_t<!std::is_void<U>::value>>
+    void set_value(continuation_detail::Stored<U> val) {
+        satisfied = true;
+        state->set_value(std::move(val));
+    }
+
+    void set_exception(std::exception_ptr err) {
+        satisfied = true;
+        state->set_exception(std::move(err));
+    }
+
+private:
+    friend struct continuation_detail::Access;
+
+    continuation_detail::StatePtr<T> state;
+    bool satisfied = false;
+};
+
+template <typename T>
+Future<std::decay_t<T>> make_ready_future(T&& val) {
+    Promise<std::decay_t<T>> promise;
+    promise.set_value(std::forward<T>(val));
+    return promise.get_future();
+}
+
+inline Future<void> make_ready_future() {
+    Promise<void> promise;
+    promise.set_value();
+    return promise.get_future();
+}
+
+// Runs func(arg...) on pool and returns a chainable Future for its result.
+template <typename Func, typename ... Arg>
+auto async_on(ThreadPool& pool, Func&& func, Arg&& ... arg) {
+    auto call = [func = std::forward<Func>(func),
+                 args = std::make_tuple(std::forward<Arg>(arg)...)]() mutable -> decltype(auto) {
+        return std::apply(func, args);
+    };
+    using R = decltype(call());
+    Promise<R> promise;
+    Future<R> fut = promise.get_future();
+    pool.post([promise = std::move(promise), call = std::move(call)]() mutable {
+        continuation_detail::fulfill(promise, call);
+    });
+    return fut;
+}
+
+// Ready once every input is; yields the values in input order, or the first
+// exception as soon as any input fails. Future<void> inputs yield Future<void>.
+template <typename T>
+auto when_all(std::vector<Future<T>> inputs) {
+    using Out = std::conditional_t<std::is_void<T>::value, void, std::vector<T>>;
+    struct Join {
+        std::atomic<size_t> remaining;
+        std::atomic<bool> failed { false };
+        std::vector<std::optional<continuation_detail::Stored<T>>> values;
+        Promise<Out> promise;
+    };
+
+    auto join = std::make_shared<Join>();
+    Future<Out> result = join->promise.get_future();
+    join->remaining = inputs.size();
+    join->values.resize(inputs.size());
+    if(inputs.empty()) {
+        if constexpr (std::is_void<T>::value) {
+            join->promise.set_value();
+        } else {
+            join->promise.set_value(Out());
+        }
+        return result;
+    }
+
+    for(size_t ii = 0; ii < inputs.size(); ++ii) {
+        auto src = std::move(continuation_detail::Access::state(inputs[ii]));
+        auto& ready = *src;
+        ready.on_ready([join, ii, src = std::move(src)]() {
+            // A failure is recorded before the count drops, so whoever drops
+            // it to zero sees it and does not also set a value.
+            if(src->exception()) {
+                if(!join->failed.exchange(true)) { join->promise.set_exception(src->exception()); }
+            } else {
+                join->values[ii].emplace(src->take());
+            }
+            if(join->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1 && !join->failed) {
+                if constexpr (std::is_void<T>::value) {
+                    join->promise.set_value();
+                } else {
+                    Out out;
+                    out.reserve(join->values.size());
+                    for(auto& val : join->values) { out.push_back(std::move(*val)); }
+                    join->promise.set_value(std::move(out));
+                }
+            }
+        });
+    }
+    return result;
+}
+
+// Ready as soon as the first input completes; yields its index and value (or
+// its exception). Future<void> inputs yield just the index. Throws
+// std::invalid_argument if inputs is empty, since no input could ever win.
+template <typename T>
+auto when_any(std::vector<Future<T>> inputs) {
+    using Out = std::conditional_t<std::is_void<T>::value, size_t, std::pair<size_t, T>>;
+    struct Race {
+        std::atomic<bool> done { false };
+        Promise<Out> promise;
+    };
+
+    if(inputs.empty()) {
+        throw std::invalid_argument("when_any: no inputs");
+    }
+    auto race = std::make_shared<Race>();
+    Future<Out> result = race->promise.get_future();
+    for(size_t ii = 0; ii < inputs.size(); ++ii) {
+        auto src = std::move(continuation_detail::Access::state(inputs[ii]));
+        auto& ready = *src;
+        ready.on_ready([race, ii, src = std::move(src)]() {
+            if(race->done.exchange(true)) { return; }
+            if(src->exception()) {
+                race->promise.set_exception(src->exception());
+            } else if constexpr (std::is_void<T>::value) {
+                race->promise.set_value(ii);
+            } else {
+                race->promise.set_value(Out(ii, src->take()));
+            }
+        });
+    }
+    return result;
+}
+
+#endif // CONTINUATION_HPP__
@@ -1,34 +1,80 @@
 #ifndef COUNTDOWN_LATCH
 #define COUNTDOWN_LATCH
 
-#include <condition_variable>
-#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 
-using std::condition_variable;
-using std::mutex;
-using std::unique_lock;
+#include "cpu_relax.hpp"
+#include "futex.hpp"
 
+// One-shot latch. Countdown() is a single atomic decrement and only enters
+// the kernel when the count reaches zero while someone sleeps in Wait();
+// then all waiters are woken. Countdown() must not be called more than
+// count times.
 class CountdownLatch {
  public:
   explicit CountdownLatch(int count) :
-    count_(count) {}
+    state_(static_cast<uint32_t>(count)) {}
+
+  CountdownLatch(const CountdownLatch&) = delete;
+  CountdownLatch& operator=(const CountdownLatch&) = delete;
 
   void Wait() {
-    unique_lock<mutex> lck(mtx_);
-    cv_.wait(lck, [this]() { return count_ == 0; });
+    if (spin_until([this]() { return TryWait(); })) {
+      return;
+    }
+    uint32_t state = state_.load(std::memory_order_acquire);
+    while ((state & kCount) != 0) {
+      if ((state & kWaiters) == 0) {
+        state = MarkWaiting();
+        continue;
+      }
+      futex_wait(state_, state);
+      state = state_.load(std::memory_order_acquire);
+    }
+  }
+
+  bool TryWait() const {
+    return (state_.load(std::memory_order_acquire) & kCount) == 0;
+  }
+
+  // Returns false if the count did not reach zero within timeout.
+  template <typename Rep, typename Period>
+  bool WaitFor(std::chrono::duration<Rep, Period> timeout) {
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    uint32_t state = state_.load(std::memory_order_acquire);
+    while ((state & kCount) != 0) {
+      if ((state & kWaiters) == 0) {
+        state = MarkWaiting();
+        continue;
+      }
+      if (!futex_wait_for(state_, state, deadline - std::chrono::steady_clock::now())) {
+        return TryWait();
+      }
+      state = state_.load(std::memory_order_acquire);
+    }
+    return true;
   }
 
   void Countdown() {
-    unique_lock<mutex> lck(mtx_);
-    if (--count_ == 0) {
-      cv_.notify_one();
+    const uint32_t prev = state_.fetch_sub(1, std::memory_order_acq_rel);
+    if (prev == (kWaiters | 1)) {
+      futex_wake_all(state_);
     }
   }
 
  private:
-  int count_;
-  mutable mutex mtx_;
-  condition_variable cv_;
+  // The low bits hold the count; kWaiters is set once someone sleeps.
+  static constexpr uint32_t kWaiters = 1u << 31;
+  static constexpr uint32_t kCount = kWaiters - 1;
+
+  // The count may have reached zero meanwhile; callers re-check it.
+  uint32_t MarkWaiting() {
+    return state_.fetch_or(kWaiters, std::memory_order_acquire) | kWaiters;
+  }
+
+  std::atomic<uint32_t> state_;
 };
 
 #endif  // COUNTDOWN_LATCH
@@ -0,0 +1,79 @@
+#ifndef CPU_RELAX_HPP__
+#define CPU_RELAX_HPP__
+
+#include <atomic>
+#include <thread>
+
+// Spin-wait hint: tells the core the thread is busy-waiting, which saves
+// power and frees pipeline resources for a sibling hardware thread.
+inline void cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    asm volatile("yield" ::: "memory");
+#else
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+#endif
+}
+
+// Exponential backoff for spin-wait loops. pause() spins for 1, 2, 4, ...
+// pause instructions, up to kMaxSpins, and yields the CPU from then on.
+class SpinBackoff
+{
+public:
+    static constexpr unsigned kMaxSpins = 64;
+
+    SpinBackoff() : spins { 1 } {}
+
+    void pause()
+    {
+        if(spins <= kMaxSpins)
+        {
+            for(unsigned ii = 0; ii < spins; ++ii)
+            {
+                cpu_relax();
+            }
+            spins <<= 1;
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    // True once pause() has reached the yielding stage.
+    bool spun_out() const { return spins > kMaxSpins; }
+
+    void reset() { spins = 1; }
+
+private:
+    unsigned spins;
+};
+
+// Short wait for done() before blocking: a few pause-spins, then a few
+// yields, so that on a busy or oversubscribed machine the thread that will
+// make done() true gets to run. Returns false if done() is still false.
+template<typename Pred>
+bool spin_until(Pred done, unsigned spins = 16, unsigned yields = 16)
+{
+    for(unsigned ii = 0; ii < spins; ++ii)
+    {
+        if(done())
+        {
+            return true;
+        }
+        cpu_relax();
+    }
+    for(unsigned ii = 0; ii < yields; ++ii)
+    {
+        if(done())
+        {
+            return true;
+        }
+        std::this_thread::yield();
+    }
+    return done();
+}
+
+#endif // CPU_RELAX_HPP__
@@ -0,0 +1,219 @@
+#ifndef CPU_TOPOLOGY_HPP__
+#define CPU_TOPOLOGY_HPP__
+
+#include <sched.h>
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+// CPU and NUMA layout of the machine, read from /sys (Linux only). Only the
+// CPUs in the process's affinity mask are reported, so cgroup/taskset limits
+// are respected. Missing /sys entries degrade to one package and one node.
+class CpuTopology
+{
+public:
+    struct Cpu
+    {
+        int id;
+        int package; // physical socket
+        int core;    // core id, unique within a package
+        int node;    // NUMA node
+        int sibling; // 0 for the first hardware thread of its core, 1 for the next, ...
+    };
+
+    // sysfs is where the kernel's "system" directory lives; tests point it
+    // at a fake tree.
+    static CpuTopology detect(const std::string & sysfs = "/sys/devices/system")
+    {
+        CpuTopology topo;
+        // Node ids can have holes (node0 and node2, say), so go by the list
+        // of online nodes rather than counting up until one is missing.
+        std::map<int, int> node_of;
+        std::string nodes;
+        if(read_line(sysfs + "/node/online", nodes))
+        {
+            for(int node : parse_cpu_list(nodes))
+            {
+                std::string list;
+                if(!read_line(sysfs + "/node/node" + std::to_string(node) + "/cpulist", list))
+                {
+                    continue;
+                }
+                for(int cpu : parse_cpu_list(list))
+                {
+                    node_of[cpu] = node;
+                }
+            }
+        }
+
+        std::string online;
+        if(!read_line(sysfs + "/cpu/online", online))
+        {
+            online = "0";
+        }
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        const bool have_mask = sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+
+        std::map<std::pair<int, int>, int> threads_per_core;
+        for(int cpu : parse_cpu_list(online))
+        {
+            if(have_mask && (cpu >= CPU_SETSIZE || !CPU_ISSET(cpu, &allowed)))
+            {
+                continue;
+            }
+            const std::string base = sysfs + "/cpu/cpu" + std::to_string(cpu) + "/topology/";
+            Cpu info { cpu, read_int(base + "physical_package_id", 0), read_int(base + "core_id", cpu), 0, 0 };
+            auto it = node_of.find(cpu);
+            info.node = it == node_of.end() ? 0 : it->second;
+            info.sibling = threads_per_core[{ info.package, info.core }]++;
+            topo.cpu_list.push_back(info);
+        }
+        return topo;
+    }
+
+    const std::vector<Cpu> & cpus() const { return cpu_list; }
+
+    std::vector<int> nodes() const
+    {
+        std::vector<int> ids;
+        for(const auto & cpu : cpu_list)
+        {
+            ids.push_back(cpu.node);
+        }
+        std::sort(ids.begin(), ids.end());
+        ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+        return ids;
+    }
+
+    std::vector<int> cpus_of_node(int node) const
+    {
+        std::vector<int> ids;
+        for(const auto & cpu : cpu_list)
+        {
+            if(cpu.node == node)
+            {
+                ids.push_back(cpu.id);
+            }
+        }
+        return ids;
+    }
+
+    // Fills one core after another (all hardware threads of a core, then the
+    // next core of the same package, then the next package), keeping
+    // neighbouring workers close to share caches.
+    std::vector<int> compact_order() const
+    {
+        auto sorted = cpu_list;
+        std::sort(sorted.begin(), sorted.end(), [](const Cpu & lhs, const Cpu & rhs)
+        {
+            return std::tie(lhs.node, lhs.package, lhs.core, lhs.sibling, lhs.id) <
+                   std::tie(rhs.node, rhs.package, rhs.core, rhs.sibling, rhs.id);
+        });
+        return ids_of(sorted);
+    }
+
+    // Spreads workers out: alternates packages, and uses the first hardware
+    // thread of every core before any second one, maximizing the cache and
+    // memory bandwidth available to each worker.
+    std::vector<int> scatter_order() const
+    {
+        std::map<int, std::vector<Cpu>> by_package;
+        for(const auto & cpu : cpu_list)
+        {
+            by_package[cpu.package].push_back(cpu);
+        }
+        std::vector<std::tuple<int, size_t, int, int>> keyed; // sibling, rank in package, package, id
+        for(auto & entry : by_package)
+        {
+            auto & list = entry.second;
+            std::sort(list.begin(), list.end(), [](const Cpu & lhs, const Cpu & rhs)
+            {
+                return std::tie(lhs.sibling, lhs.core, lhs.id) < std::tie(rhs.sibling, rhs.core, rhs.id);
+            });
+            for(size_t rank = 0; rank < list.size(); ++rank)
+            {
+                keyed.emplace_back(list[rank].sibling, rank, entry.first, list[rank].id);
+            }
+        }
+        std::sort(keyed.begin(), keyed.end());
+        std::vector<int> ids;
+        for(const auto & key : keyed)
+        {
+            ids.push_back(std::get<3>(key));
+        }
+        return ids;
+    }
+
+    // Parses the kernel's CPU list format, e.g. "0-3,8,10-11"; node lists
+    // use the same format.
+    static std::vector<int> parse_cpu_list(const std::string & list)
+    {
+        std::vector<int> ids;
+        std::stringstream ss(list);
+        std::string range;
+        while(std::getline(ss, range, ','))
+        {
+            if(range.empty())
+            {
+                continue;
+            }
+            const auto dash = range.find('-');
+            const int first = std::stoi(range.substr(0, dash));
+            const int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+            for(int cpu = first; cpu <= last; ++cpu)
+            {
+                ids.push_back(cpu);
+            }
+        }
+        return ids;
+    }
+
+    // Restricts the calling thread to the given CPUs. Returns false if the
+    // list is empty or the kernel rejects the mask.
+    static bool pin_current_thread(const std::vector<int> & cpu_ids)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for(int cpu : cpu_ids)
+        {
+            if(cpu >= 0 && cpu < CPU_SETSIZE)
+            {
+                CPU_SET(cpu, &set);
+            }
+        }
+        return CPU_COUNT(&set) > 0 && sched_setaffinity(0, sizeof(set), &set) == 0;
+    }
+
+private:
+    static bool read_line(const std::string & path, std::string & line)
+    {
+        std::ifstream in(path);
+        return static_cast<bool>(std::getline(in, line));
+    }
+
+    static int read_int(const std::string & path, int dflt)
+    {
+        std::string line;
+        return read_line(path, line) && !line.empty() ? std::stoi(line) : dflt;
+    }
+
+    static std::vector<int> ids_of(const std::vector<Cpu> & list)
+    {
+        std::vector<int> ids;
+        for(const auto & cpu : list)
+        {
+            ids.push_back(cpu.id);
+        }
+        return ids;
+    }
+
+    std::vector<Cpu> cpu_list;
+};
+
+#endif // CPU_TOPOLOGY_HPP__
@@ -0,0 +1,80 @@
+#ifndef CYCLIC_BARRIER
+#define CYCLIC_BARRIER
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <utility>
+
+#include "cpu_relax.hpp"
+#include "futex.hpp"
+
+// Reusable barrier for a fixed number of threads. The last thread to arrive
+// in a phase runs the phase callback, if any, before anyone is released, so
+// the callback sees every thread's work from the phase and its own effects
+// are seen by all threads in the next one. Waiters spin and yield briefly,
+// then sleep on a futex; the kernel is only entered when someone sleeps.
+// If the callback throws, the phase still completes and everyone else is
+// released; the exception then propagates out of the last thread's call.
+class CyclicBarrier {
+ public:
+  explicit CyclicBarrier(int parties, std::function<void()> on_phase = nullptr) :
+    parties_(static_cast<uint32_t>(parties)),
+    on_phase_(std::move(on_phase)),
+    arrived_(0),
+    phase_(0),
+    sleepers_(0) {}
+
+  CyclicBarrier(const CyclicBarrier&) = delete;
+  CyclicBarrier& operator=(const CyclicBarrier&) = delete;
+
+  // Returns true in exactly one thread per phase: the one that ran the
+  // callback.
+  bool ArriveAndWait() {
+    const uint32_t phase = phase_.load(std::memory_order_acquire);
+    if (arrived_.fetch_add(1, std::memory_order_acq_rel) + 1 == parties_) {
+      if (on_phase_) {
+        try {
+          on_phase_();
+        } catch (...) {
+          Release();
+          throw;
+        }
+      }
+      Release();
+      return true;
+    }
+
+    if (spin_until([&]() { return phase_.load(std::memory_order_acquire) != phase; })) {
+      return false;
+    }
+    sleepers_.fetch_add(1);
+    while (phase_.load() == phase) {
+      futex_wait(phase_, phase);
+    }
+    sleepers_.fetch_sub(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  // Number of completed phases.
+  uint32_t Phase() const { return phase_.load(std::memory_order_acquire); }
+
+ private:
+  void Release() {
+    arrived_.store(0, std::memory_order_relaxed);
+    phase_.fetch_add(1);
+    if (sleepers_.load() != 0) {
+      futex_wake_all(phase_);
+    }
+  }
+
+  const uint32_t parties_;
+  const std::function<void()> on_phase_;
+
+  std::atomic<uint32_t> arrived_;
+  // Bumped by the last arrival; also the futex word waiters sleep on.
+  std::atomic<uint32_t> phase_;
+  std::atomic<uint32_t> sleepers_;
+};
+
+#endif  // CYCLIC_BARRIER
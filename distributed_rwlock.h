@@ -0,0 +1,132 @@
+#ifndef _DISTRIBUTED_RWLOCK_
+#define _DISTRIBUTED_RWLOCK_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "cpu_relax.hpp"
+
+// Big-reader lock with the same interface as RwLock. Each reader counts
+// itself in one of several slots, each on its own cache line, so readers on
+// different cores never write the same line. A thread always uses the same
+// slot; threads are handed slots round-robin. Writers pay for it: they flag
+// themselves and then scan every slot until all readers have left.
+//
+// Writers are preferred: once writer is set, new readers back out and wait.
+// Use it for data that is read far more often than written.
+class DistributedRwLock {
+public:
+	// slots is rounded up to a power of two; the default is one per CPU.
+	explicit DistributedRwLock(std::size_t slots = std::thread::hardware_concurrency()) :
+		mask { RoundUp(slots) - 1 },
+		readers { new Slot[mask + 1] },
+		writer { false } {
+	}
+
+	DistributedRwLock(const DistributedRwLock &) = delete;
+
+	DistributedRwLock & operator=(const DistributedRwLock &) = delete;
+
+	void AcquireWrite() {
+		wmtx.lock();
+		writer.store(true);
+		SpinBackoff backoff;
+		while(!Drained()) {
+			if(backoff.spun_out()) {
+				std::unique_lock<std::mutex> lck(mtx);
+				wCv.wait(lck, [&]() { return Drained(); });
+				break;
+			}
+			backoff.pause();
+		}
+	}
+
+	void ReleaseWrite() {
+		writer.store(false, std::memory_order_release);
+		{
+			std::lock_guard<std::mutex> lck(mtx);
+			rCv.notify_all();
+		}
+		wmtx.unlock();
+	}
+
+	void AcquireRead() {
+		std::atomic<int> & count = Local();
+		for(;;) {
+			count.fetch_add(1);
+			if(!writer.load()) {
+				return;
+			}
+			// A writer holds or is waiting for the lock: back out and wait.
+			Leave(count);
+			std::unique_lock<std::mutex> lck(mtx);
+			rCv.wait(lck, [&]() { return !writer.load(); });
+		}
+	}
+
+	void ReleaseRead() {
+		Leave(Local());
+	}
+
+private:
+	struct alignas(64) Slot {
+		std::atomic<int> count { 0 };
+	};
+
+	static std::size_t RoundUp(std::size_t slots) {
+		std::size_t size = 1;
+		while(size < slots) {
+			size <<= 1;
+		}
+		return size;
+	}
+
+	// Index picked once per thread, shared by every DistributedRwLock.
+	static std::size_t ThreadIndex() {
+		static std::atomic<std::size_t> next { 0 };
+		thread_local const std::size_t index = next.fetch_add(1, std::memory_order_relaxed);
+		return index;
+	}
+
+	std::atomic<int> & Local() {
+		return readers[ThreadIndex() & mask].count;
+	}
+
+	// Both the reader's increment and the writer's flag are seq_cst, so
+	// either the reader sees writer or the writer's scan sees the reader.
+	bool Drained() const {
+		for(std::size_t idx = 0; idx <= mask; ++idx) {
+			if(readers[idx].count.load() != 0) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void Leave(std::atomic<int> & count) {
+		count.fetch_sub(1);
+		if(writer.load()) {
+			std::lock_guard<std::mutex> lck(mtx);
+			wCv.notify_one();
+		}
+	}
+
+	const std::size_t mask;
+	const std::unique_ptr<Slot[]> readers;
+
+	// Set while a writer holds the lock or waits for readers to drain.
+	alignas(64) std::atomic<bool> writer;
+
+	// Serializes writers.
+	std::mutex wmtx;
+
+	// Slow-path lock, and the CVs readers and writers wait on.
+	std::mutex mtx;
+	std::condition_variable rCv;
+	std::condition_variable wCv;
+};
+
+#endif // _DISTRIBUTED_RWLOCK_
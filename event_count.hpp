@@ -0,0 +1,76 @@
+#ifndef EVENT_COUNT_HPP__
+#define EVENT_COUNT_HPP__
+
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include "cpu_relax.hpp"
+#include "futex.hpp"
+
+// Lets threads sleep until a condition kept outside this object (a ring
+// being non-empty, say) becomes true, at the cost of a fence and a load on
+// the notifying side when nobody sleeps. Notifiers make the condition true
+// first and call notify_*() after; waiters call wait(done).
+class alignas(64) EventCount
+{
+public:
+    EventCount() :
+        epoch { 0 },
+        waiters { 0 }
+        {}
+
+    EventCount(const EventCount &) = delete;
+
+    EventCount & operator=(const EventCount &) = delete;
+
+    void notify_one() { notify(1); }
+
+    void notify_all() { notify(INT_MAX); }
+
+    // Returns once done() is true: spins briefly, then sleeps. done() is
+    // checked again after the thread has registered as a waiter, so a
+    // notify that races with falling asleep is not lost.
+    template<typename Pred>
+    void wait(Pred done)
+    {
+        if(spin_until(done))
+        {
+            return;
+        }
+        waiters.fetch_add(1, std::memory_order_relaxed);
+        for(;;)
+        {
+            const uint32_t seen = epoch.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if(done())
+            {
+                break;
+            }
+            futex_wait(epoch, seen);
+        }
+        waiters.fetch_sub(1, std::memory_order_release);
+    }
+
+    // True while some thread is inside the sleeping part of wait(). Threads
+    // still in the spin phase are not counted, so an owner that is about to
+    // be destroyed has to count the callers of its blocking calls itself.
+    bool has_waiters() const { return waiters.load(std::memory_order_acquire) != 0; }
+
+private:
+    // The fence pairs with the one in wait(): either the waiter sees the
+    // condition, or this sees the waiter.
+    void notify(int count)
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(waiters.load(std::memory_order_relaxed) != 0)
+        {
+            epoch.fetch_add(1, std::memory_order_relaxed);
+            futex_wake(epoch, count);
+        }
+    }
+
+    std::atomic<uint32_t> epoch;
+    std::atomic<uint32_t> waiters;
+};
+
+#endif // EVENT_COUNT_HPP__
@@ -1,46 +1,175 @@
 #ifndef FUNCTION_WRAPPER_HPP__
 #define FUNCTION_WRAPPER_HPP__
 
-#include <memory>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include "block_pool.hpp"
 
-class FunctionWrapper
+// Move-only nullary callable. A callable of up to InlineSize bytes with a
+// noexcept move constructor is stored inside the wrapper itself; anything
+// else goes to the block pool (or the heap, if over-aligned) and only a
+// pointer is stored. Calls go through a static per-type table of function
+// pointers rather than a virtual function, and moves never allocate.
+template<size_t InlineSize>
+class BasicFunctionWrapper
 {
 private:
-	struct ImplBase
+	struct VTable
 	{
-		virtual void call() = 0;
-		virtual ~ImplBase() noexcept {}
+		void (*call)(void * obj);
+		void (*move)(void * dst, void * src) noexcept; // move-constructs into dst and destroys src
+		void (*destroy)(void * obj) noexcept;
 	};
 
 	template<typename Func>
-	struct ImplType : ImplBase
+	struct InlineOps
 	{
-		Func _func;
-		ImplType(Func && func) : 
-			_func { std::move(func) }
-			{}
+		static Func * get(void * obj) { return static_cast<Func *>(obj); }
 
-		virtual void call() override { _func(); }
+		static void call(void * obj) { (*get(obj))(); }
+
+		static void move(void * dst, void * src) noexcept
+		{
+			::new(dst) Func(std::move(*get(src)));
+			get(src)->~Func();
+		}
+
+		static void destroy(void * obj) noexcept { get(obj)->~Func(); }
+
+		static constexpr VTable table { call, move, destroy };
+	};
+
+	template<typename Func>
+	struct HeapOps
+	{
+		static constexpr bool over_aligned = alignof(Func) > alignof(std::max_align_t);
+
+		// Task closures are created and destroyed on different threads at a
+		// high rate, so they come from the block pool rather than the heap.
+		static Func * create(Func && func)
+		{
+			void * mem = over_aligned ? ::operator new(sizeof(Func), std::align_val_t(alignof(Func)))
+			                          : BlockPool::allocate(sizeof(Func));
+			try
+			{
+				return ::new(mem) Func(std::move(func));
+			}
+			catch(...)
+			{
+				release(mem);
+				throw;
+			}
+		}
+
+		static void release(void * mem) noexcept
+		{
+			if(over_aligned)
+			{
+				::operator delete(mem, std::align_val_t(alignof(Func)));
+			}
+			else
+			{
+				BlockPool::deallocate(mem, sizeof(Func));
+			}
+		}
+
+		static Func * & get(void * obj) { return *static_cast<Func **>(obj); }
+
+		static void call(void * obj) { (*get(obj))(); }
+
+		static void move(void * dst, void * src) noexcept { ::new(dst) Func *(get(src)); }
+
+		static void destroy(void * obj) noexcept
+		{
+			get(obj)->~Func();
+			release(get(obj));
+		}
+
+		static constexpr VTable table { call, move, destroy };
 	};
 
-public:
 	template<typename Func>
-	FunctionWrapper(Func && func) :
-		impl { new ImplType<Func>(std::move(func)) }
-		{}
+	static constexpr bool fits_inline = sizeof(Func) <= InlineSize &&
+		alignof(Func) <= alignof(void *) && std::is_nothrow_move_constructible<Func>::value;
 
-	FunctionWrapper(FunctionWrapper && rhs) :
-		impl { std::move(rhs.impl) }
-		{}
+	static_assert(InlineSize >= sizeof(void *), "inline storage must hold at least a pointer");
 
-	FunctionWrapper(const FunctionWrapper &) = delete;
+public:
+	BasicFunctionWrapper() = default;
+
+	template<typename Func, typename = std::enable_if_t<!std::is_same<std::decay_t<Func>, BasicFunctionWrapper>::value>>
+	BasicFunctionWrapper(Func && func)
+	{
+		using Stored = std::decay_t<Func>;
+		if constexpr (fits_inline<Stored>)
+		{
+			::new(static_cast<void *>(storage)) Stored(std::forward<Func>(func));
+			vtable = &InlineOps<Stored>::table;
+		}
+		else
+		{
+			::new(static_cast<void *>(storage)) Stored *(HeapOps<Stored>::create(Stored(std::forward<Func>(func))));
+			vtable = &HeapOps<Stored>::table;
+		}
+	}
+
+	BasicFunctionWrapper(BasicFunctionWrapper && rhs) noexcept :
+		vtable { rhs.vtable }
+	{
+		if(vtable)
+		{
+			vtable->move(storage, rhs.storage);
+			rhs.vtable = nullptr;
+		}
+	}
+
+	BasicFunctionWrapper & operator=(BasicFunctionWrapper && rhs) noexcept
+	{
+		if(this != &rhs)
+		{
+			reset();
+			if(rhs.vtable)
+			{
+				rhs.vtable->move(storage, rhs.storage);
+				vtable = rhs.vtable;
+				rhs.vtable = nullptr;
+			}
+		}
+		return *this;
+	}
+
+	BasicFunctionWrapper(const BasicFunctionWrapper &) = delete;
 
-	FunctionWrapper & operator=(const FunctionWrapper &) = delete;
+	BasicFunctionWrapper & operator=(const BasicFunctionWrapper &) = delete;
 
-	void operator()() { impl->call(); }
+	~BasicFunctionWrapper() noexcept { reset(); }
+
+	void operator()() { vtable->call(storage); }
+
+	explicit operator bool() const noexcept { return vtable != nullptr; }
+
+	// True if a callable of type Func would be stored without allocating.
+	template<typename Func>
+	static constexpr bool stores_inline() { return fits_inline<std::decay_t<Func>>; }
 
 private:
-	std::unique_ptr<ImplBase> impl;
+	void reset() noexcept
+	{
+		if(vtable)
+		{
+			vtable->destroy(storage);
+			vtable = nullptr;
+		}
+	}
+
+	const VTable * vtable = nullptr;
+	alignas(void *) unsigned char storage[InlineSize];
 };
 
-#endif // FUNCTION_WRAPPER_HPP__
\ No newline at end of file
+// 48 bytes inline keeps the wrapper at 56 bytes, so a queued task plus its
+// enqueue stamp fills one cache line.
+using FunctionWrapper = BasicFunctionWrapper<48>;
+
+#endif // FUNCTION_WRAPPER_HPP__
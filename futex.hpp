@@ -0,0 +1,54 @@
+#ifndef FUTEX_HPP__
+#define FUTEX_HPP__
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <ctime>
+
+// Thin wrappers over the Linux futex syscall on a std::atomic<uint32_t>.
+// All of them use the process-private variants.
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex word must be a plain 32-bit int");
+
+inline long futex_call(std::atomic<uint32_t> & word, int op, uint32_t val, const timespec * timeout = nullptr)
+{
+    return syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), op, val, timeout, nullptr, 0);
+}
+
+// Sleeps while word == expected. May return spuriously; callers re-check.
+inline void futex_wait(std::atomic<uint32_t> & word, uint32_t expected)
+{
+    futex_call(word, FUTEX_WAIT_PRIVATE, expected);
+}
+
+// Like futex_wait(), but gives up after timeout. Returns false on timeout.
+template<typename Rep, typename Period>
+bool futex_wait_for(std::atomic<uint32_t> & word, uint32_t expected, std::chrono::duration<Rep, Period> timeout)
+{
+    if(timeout <= timeout.zero())
+    {
+        return false;
+    }
+    const auto nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(timeout).count();
+    const timespec rel { static_cast<time_t>(nanos / 1000000000), static_cast<long>(nanos % 1000000000) };
+    return futex_call(word, FUTEX_WAIT_PRIVATE, expected, &rel) == 0 || errno != ETIMEDOUT;
+}
+
+inline void futex_wake(std::atomic<uint32_t> & word, int count = 1)
+{
+    futex_call(word, FUTEX_WAKE_PRIVATE, static_cast<uint32_t>(count));
+}
+
+inline void futex_wake_all(std::atomic<uint32_t> & word)
+{
+    futex_wake(word, INT_MAX);
+}
+
+#endif // FUTEX_HPP__
@@ -0,0 +1,402 @@
+#ifndef INSTRUMENTED_LOCK_HPP__
+#define INSTRUMENTED_LOCK_HPP__
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "latency_histogram.hpp"
+
+// Contention profiling for any BasicLockable (Spinlock, std::mutex, ...)
+// and for shared locks with lock_shared()/unlock_shared() (RwLock).
+//
+// InstrumentedLock<L> is used like L. Locks are grouped by the name given at
+// construction; per name it counts acquisitions and contended acquisitions
+// and keeps wait-time and hold-time histograms, plus the call sites of the
+// contended acquisitions. LockProfiler::report() ranks the names by total
+// wait time.
+//
+// Profiling only happens with LOCK_PROFILING defined. Without it,
+// InstrumentedLock<L> is L with a name argument that is ignored, and the
+// profiler reports nothing.
+//
+// A call site is where lock() is called, so going through std::lock_guard
+// records the site inside <mutex>. Use InstrumentedLock<L>::Guard, or call
+// lock() directly, to get the caller's file and line.
+
+struct LockSite
+{
+    const char * file;
+    int line;
+    const char * function;
+
+    // Default arguments are evaluated at the call site, so these builtins
+    // report the caller of whoever takes a LockSite defaulted to current().
+    static LockSite current(const char * file = __builtin_FILE(), int line = __builtin_LINE(),
+        const char * function = __builtin_FUNCTION())
+    {
+        return LockSite { file, line, function };
+    }
+};
+
+class LockProfiler
+{
+public:
+    struct SiteReport
+    {
+        std::string file;
+        int line;
+        std::string function;
+        uint64_t contended;
+        uint64_t wait_ns;
+    };
+
+    struct LockReport
+    {
+        std::string name;
+        uint64_t acquisitions;
+        uint64_t contended;
+        LatencyHistogram::Snapshot wait;
+        LatencyHistogram::Snapshot hold;
+        std::vector<SiteReport> sites; // most waited-on first
+    };
+
+    // Aggregated data of one lock name. Recording is lock-free except for
+    // the per-site table, which is only touched on contended acquisitions.
+    class Stats
+    {
+    public:
+        void acquired(uint64_t wait_ns, bool contended, const LockSite & site)
+        {
+            acquisitions.fetch_add(1, std::memory_order_relaxed);
+            wait.record(wait_ns);
+            if(!contended)
+            {
+                return;
+            }
+            contentions.fetch_add(1, std::memory_order_relaxed);
+            std::lock_guard<std::mutex> lck(sites_mtx);
+            SiteCounters & counters = sites[std::make_tuple(site.file, site.line, site.function)];
+            ++counters.contended;
+            counters.wait_ns += wait_ns;
+        }
+
+        void released(uint64_t hold_ns) { hold.record(hold_ns); }
+
+    private:
+        friend class LockProfiler;
+
+        struct SiteCounters
+        {
+            uint64_t contended = 0;
+            uint64_t wait_ns = 0;
+        };
+
+        std::atomic<uint64_t> acquisitions { 0 };
+        std::atomic<uint64_t> contentions { 0 };
+        LatencyHistogram wait;
+        LatencyHistogram hold;
+        mutable std::mutex sites_mtx;
+        std::map<std::tuple<const char *, int, const char *>, SiteCounters> sites;
+    };
+
+    static constexpr bool enabled()
+    {
+#ifdef LOCK_PROFILING
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    static LockProfiler & instance()
+    {
+        // Leaked so that locks with static storage duration can still record
+        // during shutdown.
+        static LockProfiler * profiler = new LockProfiler();
+        return *profiler;
+    }
+
+    Stats & stats_for(const char * name)
+    {
+        std::lock_guard<std::mutex> lck(mtx);
+        std::unique_ptr<Stats> & stats = by_name[name ? name : "(unnamed)"];
+        if(!stats)
+        {
+            stats.reset(new Stats());
+        }
+        return *stats;
+    }
+
+    // Every lock name with at least one acquisition, by total wait time.
+    std::vector<LockReport> snapshot() const
+    {
+        std::vector<LockReport> reports;
+        std::lock_guard<std::mutex> lck(mtx);
+        for(const auto & entry : by_name)
+        {
+            const Stats & stats = *entry.second;
+            LockReport report;
+            report.name = entry.first;
+            report.acquisitions = stats.acquisitions.load(std::memory_order_relaxed);
+            if(report.acquisitions == 0)
+            {
+                continue;
+            }
+            report.contended = stats.contentions.load(std::memory_order_relaxed);
+            report.wait = stats.wait.snapshot();
+            report.hold = stats.hold.snapshot();
+            {
+                std::lock_guard<std::mutex> sites_lck(stats.sites_mtx);
+                for(const auto & site : stats.sites)
+                {
+                    report.sites.push_back(SiteReport { std::get<0>(site.first), std::get<1>(site.first),
+                        std::get<2>(site.first), site.second.contended, site.second.wait_ns });
+                }
+            }
+            std::sort(report.sites.begin(), report.sites.end(), [](const SiteReport & lhs, const SiteReport & rhs)
+            {
+                return lhs.wait_ns > rhs.wait_ns;
+            });
+            reports.push_back(std::move(report));
+        }
+        std::sort(reports.begin(), reports.end(), [](const LockReport & lhs, const LockReport & rhs)
+        {
+            return lhs.wait.sum > rhs.wait.sum;
+        });
+        return reports;
+    }
+
+    // Human-readable summary of the top_n locks by total wait time, with up
+    // to sites_per_lock contended call sites each.
+    std::string report(size_t top_n = 10, size_t sites_per_lock = 3) const
+    {
+        if(!enabled())
+        {
+            return "lock profiling disabled (build with LOCK_PROFILING)\n";
+        }
+        std::string out;
+        char line[512];
+        const auto reports = snapshot();
+        for(size_t idx = 0; idx < std::min(top_n, reports.size()); ++idx)
+        {
+            const LockReport & lock = reports[idx];
+            std::snprintf(line, sizeof(line),
+                "%-24s acquired %10llu  contended %5.1f%%  wait total %9.3f ms p99 %8.1f us max %8.1f us  hold p50 %7.1f us p99 %8.1f us\n",
+                lock.name.c_str(), static_cast<unsigned long long>(lock.acquisitions),
+                100.0 * lock.contended / lock.acquisitions, lock.wait.sum / 1e6, lock.wait.percentile(99) / 1e3,
+                lock.wait.max / 1e3, lock.hold.percentile(50) / 1e3, lock.hold.percentile(99) / 1e3);
+            out += line;
+            for(size_t site = 0; site < std::min(sites_per_lock, lock.sites.size()); ++site)
+            {
+                const SiteReport & from = lock.sites[site];
+                std::snprintf(line, sizeof(line), "    %s:%d (%s)  contended %llu  wait %.3f ms\n",
+                    from.file.c_str(), from.line, from.function.c_str(),
+                    static_cast<unsigned long long>(from.contended), from.wait_ns / 1e6);
+                out += line;
+            }
+        }
+        return out;
+    }
+
+    // Clears the numbers; names stay registered.
+    void reset()
+    {
+        std::lock_guard<std::mutex> lck(mtx);
+        for(auto & entry : by_name)
+        {
+            Stats & stats = *entry.second;
+            stats.acquisitions.store(0, std::memory_order_relaxed);
+            stats.contentions.store(0, std::memory_order_relaxed);
+            stats.wait.reset();
+            stats.hold.reset();
+            std::lock_guard<std::mutex> sites_lck(stats.sites_mtx);
+            stats.sites.clear();
+        }
+    }
+
+private:
+    LockProfiler() = default;
+
+    mutable std::mutex mtx;
+    std::map<std::string, std::unique_ptr<Stats>> by_name;
+};
+
+namespace instrumented_lock_detail
+{
+
+template<typename L, typename = void>
+struct has_try_lock : std::false_type {};
+
+template<typename L>
+struct has_try_lock<L, decltype(void(std::declval<L &>().try_lock()))> : std::true_type {};
+
+} // namespace instrumented_lock_detail
+
+#ifdef LOCK_PROFILING
+
+template<typename L>
+class InstrumentedLock
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit InstrumentedLock(const char * name = nullptr) :
+        stats { LockProfiler::instance().stats_for(name) }
+        {}
+
+    InstrumentedLock(const InstrumentedLock &) = delete;
+
+    InstrumentedLock & operator=(const InstrumentedLock &) = delete;
+
+    // Contended means try_lock() failed first; for locks without try_lock()
+    // it means the wait took at least kContendedNs.
+    static constexpr uint64_t kContendedNs = 1000;
+
+    void lock(LockSite site = LockSite::current())
+    {
+        if(try_inner())
+        {
+            stats.acquired(0, false, site);
+        }
+        else
+        {
+            wait_for(site, instrumented_lock_detail::has_try_lock<L>::value, [this]() { inner.lock(); });
+        }
+        hold_start = Clock::now();
+    }
+
+    bool try_lock(LockSite site = LockSite::current())
+    {
+        if(!inner.try_lock())
+        {
+            return false;
+        }
+        stats.acquired(0, false, site);
+        hold_start = Clock::now();
+        return true;
+    }
+
+    void unlock()
+    {
+        const uint64_t held = nanos(Clock::now() - hold_start);
+        inner.unlock();
+        stats.released(held);
+    }
+
+    // Shared acquisitions count towards acquisitions and wait time; there is
+    // no single holder, so they are left out of the hold-time histogram.
+    void lock_shared(LockSite site = LockSite::current())
+    {
+        wait_for(site, false, [this]() { inner.lock_shared(); });
+    }
+
+    void unlock_shared() { inner.unlock_shared(); }
+
+    // std::lock_guard replacement that records the caller's call site.
+    class Guard
+    {
+    public:
+        explicit Guard(InstrumentedLock & lock, LockSite site = LockSite::current()) :
+            lock { lock }
+        {
+            lock.lock(site);
+        }
+
+        Guard(const Guard &) = delete;
+
+        Guard & operator=(const Guard &) = delete;
+
+        ~Guard() { lock.unlock(); }
+
+    private:
+        InstrumentedLock & lock;
+    };
+
+    L & native() { return inner; }
+
+private:
+    static uint64_t nanos(Clock::duration duration)
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+    }
+
+    bool try_inner()
+    {
+        return try_inner(instrumented_lock_detail::has_try_lock<L>());
+    }
+
+    bool try_inner(std::true_type) { return inner.try_lock(); }
+
+    bool try_inner(std::false_type) { return false; }
+
+    // tried: a try_lock() has already failed, so the acquisition is
+    // contended whatever the wait.
+    template<typename Acquire>
+    void wait_for(const LockSite & site, bool tried, Acquire acquire)
+    {
+        const auto start = Clock::now();
+        acquire();
+        const uint64_t waited = nanos(Clock::now() - start);
+        stats.acquired(waited, tried || waited >= kContendedNs, site);
+    }
+
+    L inner;
+    LockProfiler::Stats & stats;
+    Clock::time_point hold_start;
+};
+
+#else
+
+// Same signatures as the profiling build, so code that passes a LockSite
+// compiles either way; the site is ignored.
+template<typename L>
+class InstrumentedLock : public L
+{
+public:
+    explicit InstrumentedLock(const char * = nullptr) {}
+
+    InstrumentedLock(const InstrumentedLock &) = delete;
+
+    InstrumentedLock & operator=(const InstrumentedLock &) = delete;
+
+    void lock(LockSite = LockSite::current()) { L::lock(); }
+
+    bool try_lock(LockSite = LockSite::current()) { return L::try_lock(); }
+
+    void lock_shared(LockSite = LockSite::current()) { L::lock_shared(); }
+
+    class Guard
+    {
+    public:
+        explicit Guard(InstrumentedLock & lock, LockSite = LockSite::current()) :
+            lock { lock }
+        {
+            lock.lock();
+        }
+
+        Guard(const Guard &) = delete;
+
+        Guard & operator=(const Guard &) = delete;
+
+        ~Guard() { lock.unlock(); }
+
+    private:
+        InstrumentedLock & lock;
+    };
+
+    L & native() { return *this; }
+};
+
+#endif // LOCK_PROFILING
+
+#endif // INSTRUMENTED_LOCK_HPP__
@@ -0,0 +1,152 @@
+#ifndef LATENCY_HISTOGRAM_HPP__
+#define LATENCY_HISTOGRAM_HPP__
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Log-linear histogram in the spirit of HdrHistogram. Values below 16 get a
+// bucket each; above that every power of two is split into 16 sub-buckets,
+// so a reported percentile is within 1/16 (6.25%) of the recorded value.
+// record() is wait-free and may be called from any thread.
+class LatencyHistogram
+{
+public:
+    static constexpr unsigned kSubBits = 4;
+    static constexpr size_t kBucketCount = (64 - kSubBits + 1) << kSubBits;
+
+    struct Snapshot
+    {
+        uint64_t count = 0;
+        uint64_t sum = 0;
+        uint64_t max = 0;
+        std::vector<uint64_t> buckets = std::vector<uint64_t>(kBucketCount);
+
+        double mean() const { return count == 0 ? 0.0 : double(sum) / count; }
+
+        // Upper bound of the bucket holding the p-th percentile, p in [0, 100].
+        uint64_t percentile(double p) const
+        {
+            if(count == 0)
+            {
+                return 0;
+            }
+            const uint64_t rank = std::max<uint64_t>(1, uint64_t(p / 100.0 * count + 0.5));
+            uint64_t seen = 0;
+            for(size_t idx = 0; idx < kBucketCount; ++idx)
+            {
+                seen += buckets[idx];
+                if(seen >= rank)
+                {
+                    return std::min(max, bucket_upper(idx));
+                }
+            }
+            return max;
+        }
+
+        void merge(const Snapshot & rhs)
+        {
+            count += rhs.count;
+            sum += rhs.sum;
+            max = std::max(max, rhs.max);
+            for(size_t idx = 0; idx < kBucketCount; ++idx)
+            {
+                buckets[idx] += rhs.buckets[idx];
+            }
+        }
+    };
+
+    LatencyHistogram() :
+        count { 0 },
+        sum { 0 },
+        max { 0 },
+        buckets {}
+        {}
+
+    LatencyHistogram(const LatencyHistogram &) = delete;
+
+    LatencyHistogram & operator=(const LatencyHistogram &) = delete;
+
+    void record(uint64_t value)
+    {
+        buckets[bucket_index(value)].fetch_add(1, std::memory_order_relaxed);
+        count.fetch_add(1, std::memory_order_relaxed);
+        sum.fetch_add(value, std::memory_order_relaxed);
+        uint64_t prev = max.load(std::memory_order_relaxed);
+        while(prev < value && !max.compare_exchange_weak(prev, value, std::memory_order_relaxed));
+    }
+
+    // record() for a histogram that only ever has one writer thread: plain
+    // loads and stores instead of locked read-modify-writes. Readers may use
+    // snapshot() concurrently.
+    void record_single_writer(uint64_t value)
+    {
+        auto & bucket = buckets[bucket_index(value)];
+        bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        sum.store(sum.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+        if(value > max.load(std::memory_order_relaxed))
+        {
+            max.store(value, std::memory_order_relaxed);
+        }
+    }
+
+    // Not atomic as a whole: a concurrent record() may be half included.
+    Snapshot snapshot() const
+    {
+        Snapshot snap;
+        snap.count = count.load(std::memory_order_relaxed);
+        snap.sum = sum.load(std::memory_order_relaxed);
+        snap.max = max.load(std::memory_order_relaxed);
+        for(size_t idx = 0; idx < kBucketCount; ++idx)
+        {
+            snap.buckets[idx] = buckets[idx].load(std::memory_order_relaxed);
+        }
+        return snap;
+    }
+
+    void reset()
+    {
+        count.store(0, std::memory_order_relaxed);
+        sum.store(0, std::memory_order_relaxed);
+        max.store(0, std::memory_order_relaxed);
+        for(auto & bucket : buckets)
+        {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    static size_t bucket_index(uint64_t value)
+    {
+        if(value < (uint64_t(1) << kSubBits))
+        {
+            return static_cast<size_t>(value);
+        }
+        const unsigned exp = 63 - __builtin_clzll(value);
+        const uint64_t sub = (value >> (exp - kSubBits)) & ((uint64_t(1) << kSubBits) - 1);
+        return (size_t(exp - kSubBits + 1) << kSubBits) + sub;
+    }
+
+    static uint64_t bucket_upper(size_t idx)
+    {
+        if(idx < (size_t(1) << kSubBits))
+        {
+            return idx;
+        }
+        const unsigned exp = static_cast<unsigned>(idx >> kSubBits) + kSubBits - 1;
+        const uint64_t sub = idx & ((size_t(1) << kSubBits) - 1);
+        const unsigned shift = exp - kSubBits;
+        const uint64_t lower = ((uint64_t(1) << kSubBits) + sub) << shift;
+        return lower + ((uint64_t(1) << shift) - 1);
+    }
+
+private:
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> sum;
+    std::atomic<uint64_t> max;
+    std::atomic<uint64_t> buckets[kBucketCount];
+};
+
+#endif // LATENCY_HISTOGRAM_HPP__
@@ -0,0 +1,175 @@
+#ifndef _MPMC_RING_QUEUE_H_
+#define _MPMC_RING_QUEUE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <thread>
+#include <utility>
+
+#include "event_count.hpp"
+
+// Lock-free bounded MPMC queue with the same Push/GetFront interface as
+// BoundedBufferQueue (D. Vyukov's ring). Every slot carries a sequence
+// number saying whose turn it is: a producer claims position pos when the
+// slot's sequence is pos, a consumer when it is pos + 1. Claiming is one CAS
+// on the shared head or tail index; nothing else is shared between a
+// producer and a consumer except the slot itself.
+//
+// Push/GetFront only block when the ring is full or empty. A blocked thread
+// spins briefly, then sleeps on a futex; the other side only makes a system
+// call when someone is actually asleep.
+//
+// The capacity is cap rounded up to a power of two.
+template<typename T>
+class MpmcRingQueue {
+public:
+	explicit MpmcRingQueue(unsigned int cap) :
+		mask_(RoundUp(cap) - 1),
+		slots_(new Slot[mask_ + 1]),
+		stop_(false),
+		head_(0),
+		tail_(0),
+		get_counter_(0),
+		push_counter_(0) {
+		for (size_t idx = 0; idx <= mask_; ++idx) {
+			slots_[idx].seq.store(idx, std::memory_order_relaxed);
+		}
+	}
+
+	MpmcRingQueue(const MpmcRingQueue&) = delete;
+	MpmcRingQueue& operator=(const MpmcRingQueue&) = delete;
+	MpmcRingQueue(MpmcRingQueue&&) = delete;
+	MpmcRingQueue& operator=(MpmcRingQueue&&) = delete;
+
+	// Returns without a value once the queue is being destroyed. Only a
+	// call that finds the ring empty counts itself for the destructor.
+	void GetFront(T *val) {
+		if (TryGetFront(val)) {
+			return;
+		}
+		++get_counter_;
+		not_empty_.wait([&]() { return stop_.load(std::memory_order_relaxed) || TryGetFront(val); });
+		get_counter_.fetch_sub(1, std::memory_order_release);
+	}
+
+	// Drops val once the queue is being destroyed. Only a call that finds
+	// the ring full counts itself for the destructor.
+	void Push(T val) {
+		if (TryPush(std::move(val))) {
+			return;
+		}
+		++push_counter_;
+		not_full_.wait([&]() { return stop_.load(std::memory_order_relaxed) || TryPush(std::move(val)); });
+		push_counter_.fetch_sub(1, std::memory_order_release);
+	}
+
+	bool TryGetFront(T *val) {
+		size_t pos = head_.load(std::memory_order_relaxed);
+		for (;;) {
+			Slot& slot = slots_[pos & mask_];
+			const size_t seq = slot.seq.load(std::memory_order_acquire);
+			const intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+			if (diff == 0) {
+				if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+					*val = std::move(*slot.value());
+					slot.value()->~T();
+					slot.seq.store(pos + mask_ + 1, std::memory_order_release);
+					not_full_.notify_one();
+					return true;
+				}
+			} else if (diff < 0) {
+				return false;  // empty
+			} else {
+				pos = head_.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	// val is only moved from on success.
+	bool TryPush(T&& val) {
+		size_t pos = tail_.load(std::memory_order_relaxed);
+		for (;;) {
+			Slot& slot = slots_[pos & mask_];
+			const size_t seq = slot.seq.load(std::memory_order_acquire);
+			const intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+			if (diff == 0) {
+				if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+					new (&slot.storage) T(std::move(val));
+					slot.seq.store(pos + 1, std::memory_order_release);
+					not_empty_.notify_one();
+					return true;
+				}
+			} else if (diff < 0) {
+				return false;  // full
+			} else {
+				pos = tail_.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	bool TryPush(const T& val) {
+		T copy(val);
+		return TryPush(std::move(copy));
+	}
+
+	// Both are approximate while other threads are pushing or popping.
+	bool IsEmpty() const { return Size() == 0; }
+
+	int Size() const {
+		const size_t head = head_.load(std::memory_order_acquire);
+		const size_t tail = tail_.load(std::memory_order_acquire);
+		return tail > head ? static_cast<int>(tail - head) : 0;
+	}
+
+	size_t Capacity() const { return mask_ + 1; }
+
+	// Releases blocked Push/GetFront callers and waits until they have left,
+	// whether they were asleep or still spinning. Calls that have not found
+	// the ring full or empty are not waited for: as with any object, they
+	// must not overlap with its destruction.
+	~MpmcRingQueue() noexcept {
+		stop_.store(true);
+		not_empty_.notify_all();
+		not_full_.notify_all();
+		while (get_counter_.load() > 0 || push_counter_.load() > 0) {
+			std::this_thread::yield();
+		}
+		const size_t tail = tail_.load(std::memory_order_relaxed);
+		for (size_t pos = head_.load(std::memory_order_relaxed); pos != tail; ++pos) {
+			slots_[pos & mask_].value()->~T();
+		}
+		delete[] slots_;
+	}
+
+private:
+	struct Slot {
+		T* value() { return std::launder(reinterpret_cast<T*>(&storage)); }
+
+		std::atomic<size_t> seq;
+		alignas(T) unsigned char storage[sizeof(T)];
+	};
+
+	static size_t RoundUp(unsigned int cap) {
+		size_t size = 1;
+		while (size < cap) {
+			size <<= 1;
+		}
+		return size;
+	}
+
+	const size_t mask_;
+	Slot* const slots_;
+	std::atomic<bool> stop_;
+	alignas(64) std::atomic<size_t> head_;  // next position to pop
+	alignas(64) std::atomic<size_t> tail_;  // next position to push
+	// Threads waiting in GetFront() and Push(). Only touched once the ring
+	// is empty or full, and kept off the lines of head_ and tail_.
+	alignas(64) std::atomic<int> get_counter_;
+	std::atomic<int> push_counter_;
+	EventCount not_empty_;  // consumers sleep here
+	EventCount not_full_;   // producers sleep here
+};
+
+#endif // _MPMC_RING_QUEUE_H_
@@ -0,0 +1,87 @@
+#ifndef NUMA_THREADPOOL_HPP__
+#define NUMA_THREADPOOL_HPP__
+
+#include <sched.h>
+
+#include <cassert>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "cpu_topology.hpp"
+#include "macro.h"
+#include "threadpool.hpp"
+
+// One ThreadPool per NUMA node, each confined to the CPUs of its node.
+// Submitting to a node keeps the task (and the memory it first touches) on
+// that node, so work can be sent to where its data lives.
+class NumaThreadPool
+{
+public:
+    DISALLOW_COPY_AND_ASSIGN(NumaThreadPool);
+
+    // threads_per_node == 0 starts one worker per CPU of each node.
+    explicit NumaThreadPool(unsigned threads_per_node = 0,
+                            ThreadPool::SchedulePolicy policy = ThreadPool::SchedulePolicy::SHARED_QUEUE,
+                            const CpuTopology& topology = CpuTopology::detect()) {
+        for(int node : topology.nodes()) {
+            const ThreadPool::Placement placement(ThreadPool::PlacementPolicy::CPU_SET,
+                                                  topology.cpus_of_node(node));
+            const unsigned size = threads_per_node > 0 ?
+                threads_per_node : static_cast<unsigned>(placement.cpus.size());
+            node_ids.push_back(node);
+            pools.emplace_back(new ThreadPool(size, policy, placement));
+        }
+        for(const auto& cpu : topology.cpus()) {
+            if(cpu.id >= static_cast<int>(node_of_cpu.size())) {
+                node_of_cpu.resize(cpu.id + 1, -1);
+            }
+            node_of_cpu[cpu.id] = cpu.node;
+        }
+        assert(!pools.empty());
+    }
+
+    const std::vector<int>& nodes() const { return node_ids; }
+
+    // Throws std::out_of_range for a node that is not in nodes().
+    ThreadPool& node_pool(int node) { return *pools[slot(node)]; }
+
+    // NUMA node of the CPU the caller is running on, or the first node.
+    int current_node() const {
+        const int cpu = sched_getcpu();
+        if(cpu >= 0 && cpu < static_cast<int>(node_of_cpu.size()) && node_of_cpu[cpu] >= 0) {
+            return node_of_cpu[cpu];
+        }
+        return node_ids.front();
+    }
+
+    template <typename Func, typename ... Arg>
+    auto execute_on(int node, Func&& func, Arg&& ... arg) {
+        return node_pool(node).execute(std::forward<Func>(func), std::forward<Arg>(arg)...);
+    }
+
+    template <typename Func, typename ... Arg>
+    void post_on(int node, Func&& func, Arg&& ... arg) {
+        node_pool(node).post(std::forward<Func>(func), std::forward<Arg>(arg)...);
+    }
+
+    // Runs on the caller's node.
+    template <typename Func, typename ... Arg>
+    auto execute(Func&& func, Arg&& ... arg) {
+        return execute_on(current_node(), std::forward<Func>(func), std::forward<Arg>(arg)...);
+    }
+
+private:
+    size_t slot(int node) const {
+        for(size_t ii = 0; ii < node_ids.size(); ++ii) {
+            if(node_ids[ii] == node) { return ii; }
+        }
+        throw std::out_of_range("NumaThreadPool: unknown NUMA node " + std::to_string(node));
+    }
+
+    std::vector<int> node_ids;
+    std::vector<std::unique_ptr<ThreadPool>> pools;
+    std::vector<int> node_of_cpu;
+};
+
+#endif // NUMA_THREADPOOL_HPP__
@@ -0,0 +1,364 @@
+#ifndef PARALLEL_ALGORITHM_HPP__
+#define PARALLEL_ALGORITHM_HPP__
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "countdown_latch.h"
+#include "cpu_relax.hpp"
+#include "threadpool.hpp"
+#include "tree_barrier.h"
+
+// Data-parallel loops on top of ThreadPool. Ranges must be random access.
+//
+// A range is split in halves recursively: the upper half is posted to the
+// pool and the lower half is processed by the current thread, down to the
+// grain size. A grain size of 0 picks one that yields about eight chunks per
+// participating thread. The calling thread takes part in the work, and while
+// it waits for forked chunks it runs queued pool tasks instead of blocking,
+// so these calls are safe from inside a pool task as well.
+
+namespace parallel_detail
+{
+
+// Counts the chunks forked to the pool and keeps the first exception thrown
+// by any of them.
+class ForkJoinGroup
+{
+public:
+    explicit ForkJoinGroup(ThreadPool & pool) :
+        pool { pool },
+        outstanding { 0 },
+        failed { false }
+        {}
+
+    ForkJoinGroup(const ForkJoinGroup &) = delete;
+
+    ForkJoinGroup & operator=(const ForkJoinGroup &) = delete;
+
+    template<typename Func>
+    void fork(Func func)
+    {
+        outstanding.fetch_add(1, std::memory_order_relaxed);
+        pool.post([this, func]() mutable
+        {
+            run(func);
+            // Last touch of this group; the waiter may destroy it right after.
+            outstanding.fetch_sub(1, std::memory_order_release);
+        });
+    }
+
+    template<typename Func>
+    void run(Func & func)
+    {
+        try
+        {
+            func();
+        }
+        catch(...)
+        {
+            if(!failed.exchange(true))
+            {
+                error = std::current_exception();
+            }
+        }
+    }
+
+    void wait()
+    {
+        while(outstanding.load(std::memory_order_acquire) > 0)
+        {
+            if(!pool.run_pending_task())
+            {
+                std::this_thread::yield();
+            }
+        }
+        if(error)
+        {
+            std::rethrow_exception(error);
+        }
+    }
+
+private:
+    ThreadPool & pool;
+    std::atomic<long> outstanding;
+    std::atomic<bool> failed;
+    std::exception_ptr error;
+};
+
+template<typename Body>
+void split_range(ForkJoinGroup & group, size_t lo, size_t hi, size_t grain, const Body & body)
+{
+    while(hi - lo > grain)
+    {
+        const size_t mid = lo + (hi - lo) / 2;
+        group.fork([&group, mid, hi, grain, &body]() { split_range(group, mid, hi, grain, body); });
+        hi = mid;
+    }
+    body(lo, hi);
+}
+
+inline size_t auto_grain(const ThreadPool & pool, size_t n)
+{
+    const size_t chunks = 8 * (static_cast<size_t>(pool.size()) + 1);
+    return std::max<size_t>(1, n / chunks);
+}
+
+} // namespace parallel_detail
+
+// Calls body(lo, hi) on disjoint sub-ranges covering [0, n).
+template<typename Body>
+void parallel_for_blocks(ThreadPool & pool, size_t n, Body body, size_t grain = 0)
+{
+    if(n == 0)
+    {
+        return;
+    }
+    if(grain == 0)
+    {
+        grain = parallel_detail::auto_grain(pool, n);
+    }
+    parallel_detail::ForkJoinGroup group(pool);
+    auto root = [&]() { parallel_detail::split_range(group, 0, n, grain, body); };
+    group.run(root);
+    group.wait();
+}
+
+template<typename It, typename Func>
+void parallel_for(ThreadPool & pool, It first, It last, Func func, size_t grain = 0)
+{
+    const size_t n = std::distance(first, last);
+    parallel_for_blocks(pool, n, [first, &func](size_t lo, size_t hi)
+    {
+        for(It it = first + lo, end = first + hi; it != end; ++it)
+        {
+            func(*it);
+        }
+    }, grain);
+}
+
+// Writes func(first[i]) to out[i]; returns the end of the output range.
+template<typename It, typename OutIt, typename Func>
+OutIt parallel_transform(ThreadPool & pool, It first, It last, OutIt out, Func func, size_t grain = 0)
+{
+    const size_t n = std::distance(first, last);
+    parallel_for_blocks(pool, n, [first, out, &func](size_t lo, size_t hi)
+    {
+        OutIt dst = out + lo;
+        for(It it = first + lo, end = first + hi; it != end; ++it, ++dst)
+        {
+            *dst = func(*it);
+        }
+    }, grain);
+    return out + n;
+}
+
+// op must be associative. Partial results are combined left to right, so
+// op need not be commutative.
+template<typename It, typename T, typename BinaryOp>
+T parallel_reduce(ThreadPool & pool, It first, It last, T init, BinaryOp op, size_t grain = 0)
+{
+    const size_t n = std::distance(first, last);
+    if(n == 0)
+    {
+        return init;
+    }
+    if(grain == 0)
+    {
+        grain = parallel_detail::auto_grain(pool, n);
+    }
+    const size_t blocks = (n + grain - 1) / grain;
+    std::vector<T> partial(blocks, init);
+    parallel_for_blocks(pool, blocks, [&](size_t lo, size_t hi)
+    {
+        for(size_t blk = lo; blk < hi; ++blk)
+        {
+            It it = first + blk * grain;
+            const It end = first + std::min(n, (blk + 1) * grain);
+            T acc = *it;
+            for(++it; it != end; ++it)
+            {
+                acc = op(std::move(acc), *it);
+            }
+            partial[blk] = std::move(acc);
+        }
+    }, 1);
+
+    T result = std::move(init);
+    for(auto & val : partial)
+    {
+        result = op(std::move(result), std::move(val));
+    }
+    return result;
+}
+
+// Three passes over fixed blocks: reduce each block in parallel, scan the
+// block totals serially, then scan each block in parallel from its carry.
+template<typename It, typename OutIt, typename BinaryOp>
+OutIt parallel_inclusive_scan(ThreadPool & pool, It first, It last, OutIt out, BinaryOp op, size_t grain = 0)
+{
+    using T = typename std::iterator_traits<It>::value_type;
+
+    const size_t n = std::distance(first, last);
+    if(n == 0)
+    {
+        return out;
+    }
+    if(grain == 0)
+    {
+        grain = parallel_detail::auto_grain(pool, n);
+    }
+    const size_t blocks = (n + grain - 1) / grain;
+    std::vector<T> totals;
+    totals.reserve(blocks);
+    for(size_t blk = 0; blk < blocks; ++blk)
+    {
+        totals.push_back(first[blk * grain]);
+    }
+
+    parallel_for_blocks(pool, blocks - 1, [&](size_t lo, size_t hi)
+    {
+        for(size_t blk = lo; blk < hi; ++blk)
+        {
+            T acc = std::move(totals[blk]);
+            for(size_t ii = blk * grain + 1, end = (blk + 1) * grain; ii < end; ++ii)
+            {
+                acc = op(std::move(acc), first[ii]);
+            }
+            totals[blk] = std::move(acc);
+        }
+    }, 1);
+
+    // totals[blk] becomes the inclusive prefix up to the end of block blk.
+    for(size_t blk = 1; blk + 1 < blocks; ++blk)
+    {
+        totals[blk] = op(totals[blk - 1], std::move(totals[blk]));
+    }
+
+    parallel_for_blocks(pool, blocks, [&](size_t lo, size_t hi)
+    {
+        for(size_t blk = lo; blk < hi; ++blk)
+        {
+            const size_t begin = blk * grain;
+            const size_t end = std::min(n, begin + grain);
+            T acc = blk == 0 ? T(first[0]) : op(totals[blk - 1], first[begin]);
+            out[begin] = acc;
+            for(size_t ii = begin + 1; ii < end; ++ii)
+            {
+                acc = op(std::move(acc), first[ii]);
+                out[ii] = acc;
+            }
+        }
+    }, 1);
+    return out + n;
+}
+
+// Phase-parallel loop: body(worker, phase) is called for every worker in
+// [0, workers) and every phase 0, 1, ..., phases - 1, and all calls of a
+// phase finish before any call of the next one starts. between(), if given,
+// runs on one thread between phases. If body throws, the loop stops after
+// the current phase and the first exception is rethrown.
+//
+// The worker ids are spread over the caller and the pool threads that are
+// free to join. The caller posts up to workers - 1 helpers and runs queued
+// pool tasks until each of them has either started on another thread or
+// been run by the caller itself, in which case it stays out. So the loop
+// does not wait for threads that are not coming (a busy pool, or a call
+// from inside a pool task), but a thread may then run several ids of a
+// phase one after another: calls of the same phase must not wait for each
+// other.
+template<typename Body>
+void parallel_phases(ThreadPool & pool, unsigned workers, size_t phases, Body body,
+    std::function<void()> between = nullptr)
+{
+    if(workers == 0 || phases == 0)
+    {
+        return;
+    }
+    const std::thread::id caller = std::this_thread::get_id();
+    const unsigned helpers = std::min(workers - 1, pool.size());
+    std::atomic<unsigned> settled { 0 }; // helpers that joined or stayed out
+    std::atomic<unsigned> joined { 1 }; // the caller is participant 0
+    unsigned participants = 1;
+    std::unique_ptr<TreeBarrier> barrier;
+    CountdownLatch ready(1);
+    // The phase in which body threw. A participant still leaving the
+    // previous barrier may see it set, so it is compared, not just tested.
+    std::atomic<size_t> failed_phase { phases };
+
+    auto participate = [&](unsigned self)
+    {
+        std::exception_ptr error;
+        for(size_t phase = 0; phase < phases; ++phase)
+        {
+            try
+            {
+                for(unsigned id = self; id < workers; id += participants)
+                {
+                    body(id, phase);
+                }
+            }
+            catch(...)
+            {
+                error = std::current_exception();
+                failed_phase.store(phase, std::memory_order_relaxed);
+            }
+            barrier->ArriveAndWait(self);
+            if(failed_phase.load(std::memory_order_relaxed) <= phase)
+            {
+                break;
+            }
+        }
+        if(error)
+        {
+            std::rethrow_exception(error);
+        }
+    };
+
+    parallel_detail::ForkJoinGroup group(pool);
+    for(unsigned ii = 0; ii < helpers; ++ii)
+    {
+        group.fork([&]()
+        {
+            if(std::this_thread::get_id() == caller)
+            {
+                settled.fetch_add(1, std::memory_order_release);
+                return;
+            }
+            const unsigned self = joined.fetch_add(1, std::memory_order_relaxed);
+            settled.fetch_add(1, std::memory_order_release);
+            ready.Wait();
+            participate(self);
+        });
+    }
+    auto first = [&]()
+    {
+        // Idle workers get a moment to pick the helpers up before the caller
+        // starts taking queued tasks itself.
+        auto all_settled = [&]() { return settled.load(std::memory_order_acquire) == helpers; };
+        if(!spin_until(all_settled))
+        {
+            while(!all_settled())
+            {
+                if(!pool.run_pending_task())
+                {
+                    std::this_thread::yield();
+                }
+            }
+        }
+        participants = joined.load(std::memory_order_relaxed);
+        barrier.reset(new TreeBarrier(participants, std::move(between)));
+        ready.Countdown();
+        participate(0);
+    };
+    group.run(first);
+    group.wait();
+}
+
+#endif // PARALLEL_ALGORITHM_HPP__
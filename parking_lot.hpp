@@ -0,0 +1,222 @@
+#ifndef PARKING_LOT_HPP__
+#define PARKING_LOT_HPP__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include "cpu_relax.hpp"
+#include "futex.hpp"
+#include "spinlock.hpp"
+
+// Global parking lot: threads wait on any address without that address
+// holding a queue, so a lock or flag can be a single byte. Parked threads
+// sit in a fixed table of buckets hashed by address; each bucket has a
+// small spinlock and a FIFO of waiters, and a parked thread sleeps on a
+// futex word of its own. Addresses that hash to the same bucket share its
+// queue, which only costs a longer walk.
+//
+// The validation passed to park() and the callbacks passed to unpark_one()
+// and unpark_all() run under the bucket lock, so a primitive can update its
+// state word atomically with respect to threads parking on it.
+
+namespace parking_lot
+{
+
+struct UnparkResult
+{
+    bool did_unpark;
+    bool have_more; // other threads are still parked on the address
+};
+
+namespace detail
+{
+
+struct ParkedThread
+{
+    const void * address = nullptr;
+    ParkedThread * next = nullptr;
+    std::atomic<uint32_t> woken { 0 };
+};
+
+struct alignas(64) Bucket
+{
+    Spinlock lock;
+    ParkedThread * head = nullptr;
+    ParkedThread * tail = nullptr;
+};
+
+constexpr size_t kBuckets = 512;
+
+inline Bucket & bucket_for(const void * address)
+{
+    static Bucket buckets[kBuckets];
+    const uint64_t hash = reinterpret_cast<uintptr_t>(address) * 0x9E3779B97F4A7C15ULL;
+    return buckets[hash >> 55];
+}
+
+static_assert(kBuckets == 1 << 9, "bucket_for() takes the top 9 bits of the hash");
+
+inline ParkedThread & self()
+{
+    thread_local ParkedThread me;
+    return me;
+}
+
+// Unlinks node, which follows prev (nullptr if node is the head).
+inline ParkedThread * unlink_after(Bucket & bucket, ParkedThread * prev, ParkedThread * node)
+{
+    (prev ? prev->next : bucket.head) = node->next;
+    if(bucket.tail == node)
+    {
+        bucket.tail = prev;
+    }
+    return node;
+}
+
+// Values of ParkedThread::woken. A parked thread leaves park() only at
+// kWoken, which is the waker's last access: the ParkedThread is thread_local
+// and goes away with its thread, so it must not be freed under the
+// futex_wake() still being issued for it.
+constexpr uint32_t kParked = 0;
+constexpr uint32_t kWaking = 1;
+constexpr uint32_t kWoken = 2;
+
+inline void wake(ParkedThread * thread)
+{
+    thread->woken.store(kWaking, std::memory_order_release);
+    futex_wake(thread->woken);
+    thread->woken.store(kWoken, std::memory_order_release);
+}
+
+} // namespace detail
+
+// Parks the calling thread on address if validate() returns true; both
+// happen under the bucket lock. before_sleep() runs once the thread is
+// queued, outside the lock (e.g. to release a user lock). Returns false
+// without sleeping if validation failed, true once unparked.
+template<typename Validate, typename BeforeSleep>
+bool park(const void * address, Validate validate, BeforeSleep before_sleep)
+{
+    detail::ParkedThread & me = detail::self();
+    detail::Bucket & bucket = detail::bucket_for(address);
+    {
+        std::lock_guard<Spinlock> lck(bucket.lock);
+        if(!validate())
+        {
+            return false;
+        }
+        me.address = address;
+        me.next = nullptr;
+        me.woken.store(detail::kParked, std::memory_order_relaxed);
+        (bucket.tail ? bucket.tail->next : bucket.head) = &me;
+        bucket.tail = &me;
+    }
+    before_sleep();
+    SpinBackoff backoff;
+    for(;;)
+    {
+        const uint32_t state = me.woken.load(std::memory_order_acquire);
+        if(state == detail::kWoken)
+        {
+            return true;
+        }
+        if(state == detail::kParked)
+        {
+            futex_wait(me.woken, detail::kParked);
+        }
+        else
+        {
+            // The waker is between its two stores, a syscall apart.
+            backoff.pause();
+        }
+    }
+}
+
+template<typename Validate>
+bool park(const void * address, Validate validate)
+{
+    return park(address, validate, []() {});
+}
+
+// Wakes the longest-parked thread on address. callback(UnparkResult) runs
+// under the bucket lock, whether or not a thread was found.
+template<typename Callback>
+void unpark_one(const void * address, Callback callback)
+{
+    detail::Bucket & bucket = detail::bucket_for(address);
+    detail::ParkedThread * found = nullptr;
+    {
+        std::lock_guard<Spinlock> lck(bucket.lock);
+        detail::ParkedThread * prev = nullptr;
+        for(detail::ParkedThread * node = bucket.head; node; prev = node, node = node->next)
+        {
+            if(node->address == address)
+            {
+                found = detail::unlink_after(bucket, prev, node);
+                break;
+            }
+        }
+        UnparkResult result { found != nullptr, false };
+        for(detail::ParkedThread * node = found ? found->next : nullptr; node; node = node->next)
+        {
+            if(node->address == address)
+            {
+                result.have_more = true;
+                break;
+            }
+        }
+        callback(result);
+    }
+    if(found)
+    {
+        detail::wake(found);
+    }
+}
+
+// Wakes every thread parked on address; returns how many. callback(count)
+// runs under the bucket lock once they have been dequeued.
+template<typename Callback>
+size_t unpark_all(const void * address, Callback callback)
+{
+    detail::Bucket & bucket = detail::bucket_for(address);
+    detail::ParkedThread * woken = nullptr;
+    size_t count = 0;
+    {
+        std::lock_guard<Spinlock> lck(bucket.lock);
+        detail::ParkedThread * prev = nullptr;
+        for(detail::ParkedThread * node = bucket.head; node; )
+        {
+            detail::ParkedThread * const next = node->next;
+            if(node->address == address)
+            {
+                detail::unlink_after(bucket, prev, node)->next = woken;
+                woken = node;
+                ++count;
+            }
+            else
+            {
+                prev = node;
+            }
+            node = next;
+        }
+        callback(count);
+    }
+    while(woken)
+    {
+        // Read next before the thread can run off and reuse its node.
+        detail::ParkedThread * const next = woken->next;
+        detail::wake(woken);
+        woken = next;
+    }
+    return count;
+}
+
+inline size_t unpark_all(const void * address)
+{
+    return unpark_all(address, [](size_t) {});
+}
+
+} // namespace parking_lot
+
+#endif // PARKING_LOT_HPP__
@@ -0,0 +1,238 @@
+#ifndef QUEUE_LOCK_HPP__
+#define QUEUE_LOCK_HPP__
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+#include "cpu_relax.hpp"
+
+// FIFO spin locks with the same lock()/unlock() interface as Spinlock, for
+// use with std::lock_guard, plus try_lock() where it can be done safely.
+// Waiters are served in arrival order, so no thread starves. Like Spinlock,
+// waiters back off to yielding after a short spin; that keeps an
+// oversubscribed machine moving but does not change the order in which the
+// lock is granted.
+
+namespace queue_lock_detail
+{
+
+// Per-thread free list of queue nodes, so lock() needs no caller-provided
+// node and never allocates once a thread has warmed up.
+template<typename Node>
+class NodeCache
+{
+public:
+    static Node * acquire()
+    {
+        auto & nodes = local().free;
+        if(nodes.empty())
+        {
+            return new Node();
+        }
+        Node * node = nodes.back();
+        nodes.pop_back();
+        return node;
+    }
+
+    static void release(Node * node) { local().free.push_back(node); }
+
+private:
+    ~NodeCache()
+    {
+        for(Node * node : free)
+        {
+            delete node;
+        }
+    }
+
+    static NodeCache & local()
+    {
+        thread_local NodeCache cache;
+        return cache;
+    }
+
+    std::vector<Node *> free;
+};
+
+} // namespace queue_lock_detail
+
+// Ticket lock: take a number, wait until it is served. Waiters all read
+// the same now_serving line, but only unlock() writes it.
+class TicketLock
+{
+public:
+    TicketLock() :
+        next_ticket { 0 },
+        now_serving { 0 }
+        {}
+
+    TicketLock(const TicketLock &) = delete;
+
+    TicketLock & operator=(const TicketLock &) = delete;
+
+    void lock()
+    {
+        const uint32_t ticket = next_ticket.fetch_add(1, std::memory_order_relaxed);
+        SpinBackoff backoff;
+        while(now_serving.load(std::memory_order_acquire) != ticket)
+        {
+            backoff.pause();
+        }
+    }
+
+    bool try_lock()
+    {
+        uint32_t ticket = now_serving.load(std::memory_order_acquire);
+        return next_ticket.compare_exchange_strong(ticket, ticket + 1, std::memory_order_acquire, std::memory_order_relaxed);
+    }
+
+    void unlock()
+    {
+        now_serving.store(now_serving.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+private:
+    alignas(64) std::atomic<uint32_t> next_ticket;
+    alignas(64) std::atomic<uint32_t> now_serving;
+};
+
+// Mellor-Crummey/Scott lock: waiters form a linked queue and each spins on
+// a flag in its own node, on its own cache line, so a handover touches only
+// the next waiter's line.
+class MCSLock
+{
+public:
+    MCSLock() :
+        tail { nullptr },
+        holder { nullptr }
+        {}
+
+    MCSLock(const MCSLock &) = delete;
+
+    MCSLock & operator=(const MCSLock &) = delete;
+
+    void lock()
+    {
+        Node * node = Cache::acquire();
+        node->next.store(nullptr, std::memory_order_relaxed);
+        node->waiting.store(true, std::memory_order_relaxed);
+        Node * prev = tail.exchange(node, std::memory_order_acq_rel);
+        if(prev != nullptr)
+        {
+            prev->next.store(node, std::memory_order_release);
+            SpinBackoff backoff;
+            while(node->waiting.load(std::memory_order_acquire))
+            {
+                backoff.pause();
+            }
+        }
+        holder = node;
+    }
+
+    bool try_lock()
+    {
+        Node * node = Cache::acquire();
+        node->next.store(nullptr, std::memory_order_relaxed);
+        Node * expected = nullptr;
+        if(!tail.compare_exchange_strong(expected, node, std::memory_order_acquire, std::memory_order_relaxed))
+        {
+            Cache::release(node);
+            return false;
+        }
+        holder = node;
+        return true;
+    }
+
+    void unlock()
+    {
+        Node * node = holder;
+        Node * next = node->next.load(std::memory_order_acquire);
+        if(next == nullptr)
+        {
+            Node * expected = node;
+            if(tail.compare_exchange_strong(expected, nullptr, std::memory_order_release, std::memory_order_relaxed))
+            {
+                Cache::release(node);
+                return;
+            }
+            // A successor has swapped itself in but not linked up yet.
+            while((next = node->next.load(std::memory_order_acquire)) == nullptr)
+            {
+                cpu_relax();
+            }
+        }
+        next->waiting.store(false, std::memory_order_release);
+        Cache::release(node);
+    }
+
+private:
+    struct alignas(64) Node
+    {
+        std::atomic<Node *> next;
+        std::atomic<bool> waiting;
+    };
+
+    using Cache = queue_lock_detail::NodeCache<Node>;
+
+    alignas(64) std::atomic<Node *> tail;
+    Node * holder; // only touched by the thread holding the lock
+};
+
+// Craig/Landin-Hagersten lock: an implicit queue where each waiter spins on
+// its predecessor's node. Simpler handover than MCS (unlock() is a single
+// store), at the cost of spinning on a line another thread owns. Nodes
+// migrate: unlock() keeps the predecessor's node for the next lock(). There
+// is no try_lock(): a recycled node can reappear at the tail, so a CAS on
+// the tail cannot tell that the lock is free.
+class CLHLock
+{
+public:
+    CLHLock() :
+        tail { Cache::acquire() },
+        holder { nullptr },
+        holder_pred { nullptr }
+    {
+        tail.load(std::memory_order_relaxed)->locked.store(false, std::memory_order_relaxed);
+    }
+
+    CLHLock(const CLHLock &) = delete;
+
+    CLHLock & operator=(const CLHLock &) = delete;
+
+    ~CLHLock() noexcept { delete tail.load(std::memory_order_relaxed); }
+
+    void lock()
+    {
+        Node * node = Cache::acquire();
+        node->locked.store(true, std::memory_order_relaxed);
+        Node * pred = tail.exchange(node, std::memory_order_acq_rel);
+        SpinBackoff backoff;
+        while(pred->locked.load(std::memory_order_acquire))
+        {
+            backoff.pause();
+        }
+        holder = node;
+        holder_pred = pred;
+    }
+
+    void unlock()
+    {
+        Node * pred = holder_pred;
+        holder->locked.store(false, std::memory_order_release);
+        Cache::release(pred);
+    }
+
+private:
+    struct alignas(64) Node
+    {
+        std::atomic<bool> locked;
+    };
+
+    using Cache = queue_lock_detail::NodeCache<Node>;
+
+    alignas(64) std::atomic<Node *> tail;
+    Node * holder; // only touched by the thread holding the lock
+    Node * holder_pred;
+};
+
+#endif // QUEUE_LOCK_HPP__
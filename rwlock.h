@@ -5,47 +5,145 @@
 #include <condition_variable>
 #include <mutex>
 
+// Readers enter and leave with a single atomic add on counter while no
+// writer is around; mtx and the condition variables are only used when
+// someone has to wait. Writers are serialized by wmtx.
+//
+// READER preference (the default) lets readers in until the lock is free of
+// readers, so a steady stream of readers can starve a writer. WRITER
+// preference blocks new readers as soon as a writer arrives, and the writer
+// only waits for the readers already inside.
+//
+// An upgradeable reader shares the lock with plain readers but excludes
+// writers and other upgradeable readers, so it can later turn into a writer
+// without anyone writing in between. A writer can also downgrade to a reader.
 class RwLock {
 public:
-	RwLock() :
-		counter { 0 } {
+	enum class Preference {
+		READER,
+		WRITER
+	};
+
+	explicit RwLock(Preference preference = Preference::READER) :
+		preference { preference },
+		counter { 0 },
+		writerWaiting { false } {
 	}
 
+	RwLock(const RwLock &) = delete;
+
+	RwLock & operator=(const RwLock &) = delete;
+
 	void AcquireWrite() {
-		std::unique_lock<std::mutex> lck(mtx);
-		wCv.wait(lck, [&]() { return counter == 0; });
-		--counter;
+		wmtx.lock();
+		if(preference == Preference::WRITER) {
+			if((counter.fetch_add(WRITER, std::memory_order_acquire) & READERS) != 0) {
+				std::unique_lock<std::mutex> lck(mtx);
+				wCv.wait(lck, [&]() { return (counter.load() & READERS) == 0; });
+			}
+			return;
+		}
+		for(;;) {
+			int expected = 0;
+			if(counter.compare_exchange_strong(expected, WRITER, std::memory_order_acquire)) {
+				return;
+			}
+			std::unique_lock<std::mutex> lck(mtx);
+			writerWaiting = true;
+			wCv.wait(lck, [&]() { return counter.load() == 0; });
+			writerWaiting = false;
+		}
 	}
 
 	void ReleaseWrite() {
-		std::unique_lock<std::mutex> lck(mtx);
-		counter = 0;
-		rCv.notify_all();
+		counter.fetch_sub(WRITER, std::memory_order_release);
+		{
+			std::lock_guard<std::mutex> lck(mtx);
+			rCv.notify_all();
+		}
+		wmtx.unlock();
 	}
 
 	void AcquireRead() {
-		std::unique_lock<std::mutex> lck(mtx);
-		rCv.wait(lck, [&]() { return counter >= 0; });
-		++counter;
+		for(;;) {
+			if((counter.fetch_add(1, std::memory_order_acquire) & WRITER) == 0) {
+				return;
+			}
+			// A writer holds or is waiting for the lock: back out and wait.
+			ReleaseRead();
+			std::unique_lock<std::mutex> lck(mtx);
+			rCv.wait(lck, [&]() { return (counter.load() & WRITER) == 0; });
+		}
 	}
 
 	void ReleaseRead() {
-		std::unique_lock<std::mutex> lck(mtx);
-		--counter;
-		wCv.notify_one();
+		const int now = counter.fetch_sub(1) - 1;
+		// Last reader out while a writer waits for the readers to drain.
+		if(now == WRITER || (now == 0 && writerWaiting.load())) {
+			std::lock_guard<std::mutex> lck(mtx);
+			wCv.notify_one();
+		}
+	}
+
+	// Holding wmtx keeps writers out, so the read count always goes in.
+	void AcquireUpgradeable() {
+		wmtx.lock();
+		counter.fetch_add(1, std::memory_order_acquire);
+	}
+
+	void ReleaseUpgradeable() {
+		ReleaseRead();
+		wmtx.unlock();
+	}
+
+	// Turns the upgradeable read into the write lock: new readers are held
+	// back, and the ones inside are waited for. Release with ReleaseWrite.
+	void UpgradeToWrite() {
+		if((counter.fetch_add(WRITER - 1, std::memory_order_acquire) & READERS) != 1) {
+			std::unique_lock<std::mutex> lck(mtx);
+			wCv.wait(lck, [&]() { return (counter.load() & READERS) == 0; });
+		}
 	}
 
+	// Turns the write lock into a read lock, letting waiting readers in.
+	// Release with ReleaseRead.
+	void DowngradeToRead() {
+		counter.fetch_add(1 - WRITER, std::memory_order_release);
+		{
+			std::lock_guard<std::mutex> lck(mtx);
+			rCv.notify_all();
+		}
+		wmtx.unlock();
+	}
+
+	// Standard names, for std::unique_lock, std::shared_lock and wrappers
+	// such as InstrumentedLock.
+	void lock() { AcquireWrite(); }
+	void unlock() { ReleaseWrite(); }
+	void lock_shared() { AcquireRead(); }
+	void unlock_shared() { ReleaseRead(); }
+
 private:
-	// The global lock.
-	std::mutex mtx;
+	// counter holds the number of readers inside (or briefly backing out)
+	// plus WRITER while a writer holds the lock or, with WRITER preference,
+	// waits for it.
+	static constexpr int WRITER = 1 << 30;
+	static constexpr int READERS = WRITER - 1;
 
-	// CV for read and write.
+	const Preference preference;
+
+	// Serializes writers and upgradeable readers.
+	std::mutex wmtx;
+
+	// Slow-path lock, and the CVs readers and writers wait on.
+	std::mutex mtx;
 	std::condition_variable rCv;
 	std::condition_variable wCv;
 
-	// Counter to represent rwlock state.
-	// 0 for free, positive for reader share, -1 for write exclusive.
 	std::atomic<int> counter;
+
+	// With READER preference, set while a writer waits for counter to reach 0.
+	std::atomic<bool> writerWaiting;
 };
 
-#endif // _RWLOCK_
\ No newline at end of file
+#endif // _RWLOCK_
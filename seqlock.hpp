@@ -0,0 +1,133 @@
+#ifndef SEQLOCK_HPP__
+#define SEQLOCK_HPP__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <type_traits>
+#include "cpu_relax.hpp"
+#include "spinlock.hpp"
+
+// Sequence lock around a small trivially copyable value. Readers never write
+// shared memory: they copy the value and retry if a writer was active
+// meanwhile (odd sequence) or finished in between (sequence changed). Writers
+// are serialized by a Spinlock, so a reader can be held up by a stream of
+// writes, but never a writer by readers.
+//
+// The value is kept as an array of atomic words, so the racy copy a reader
+// may make while a write is in progress is not a data race. A torn copy is
+// always detected by the sequence check and thrown away.
+template<typename T>
+class alignas(64) SeqLock
+{
+    static_assert(std::is_trivially_copyable<T>::value, "SeqLock needs a trivially copyable type");
+
+public:
+    SeqLock() :
+        SeqLock(T {})
+        {}
+
+    explicit SeqLock(const T & value) :
+        seq { 0 }
+    {
+        write_words(value);
+    }
+
+    SeqLock(const SeqLock & rhs) = delete;
+
+    SeqLock & operator=(const SeqLock & rhs) = delete;
+
+    T load() const
+    {
+        T value;
+        SpinBackoff backoff;
+        while(!try_load(value))
+        {
+            backoff.pause();
+        }
+        return value;
+    }
+
+    // A single optimistic attempt; false if it raced with a writer.
+    bool try_load(T & value) const
+    {
+        const uint64_t before = seq.load(std::memory_order_acquire);
+        if(before & 1)
+        {
+            return false;
+        }
+        Word buf[kWords];
+        for(size_t idx = 0; idx < kWords; ++idx)
+        {
+            buf[idx] = words[idx].load(std::memory_order_relaxed);
+        }
+        // Orders the word loads before the re-check of the sequence.
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if(seq.load(std::memory_order_relaxed) != before)
+        {
+            return false;
+        }
+        std::memcpy(&value, buf, sizeof(T));
+        return true;
+    }
+
+    void store(const T & value)
+    {
+        std::lock_guard<Spinlock> lck(writer);
+        begin_write();
+        write_words(value);
+        end_write();
+    }
+
+    // Read-modify-write under the writer lock: func(T &) edits the value.
+    template<typename Func>
+    void update(Func && func)
+    {
+        std::lock_guard<Spinlock> lck(writer);
+        Word buf[kWords];
+        for(size_t idx = 0; idx < kWords; ++idx)
+        {
+            buf[idx] = words[idx].load(std::memory_order_relaxed);
+        }
+        T value;
+        std::memcpy(&value, buf, sizeof(T));
+        func(value);
+        begin_write();
+        write_words(value);
+        end_write();
+    }
+
+private:
+    using Word = uint64_t;
+    static constexpr size_t kWords = (sizeof(T) + sizeof(Word) - 1) / sizeof(Word);
+
+    void begin_write()
+    {
+        seq.store(seq.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        // Keeps the word stores below from being seen before the odd sequence.
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    void end_write()
+    {
+        seq.store(seq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    void write_words(const T & value)
+    {
+        Word buf[kWords] = {};
+        std::memcpy(buf, &value, sizeof(T));
+        for(size_t idx = 0; idx < kWords; ++idx)
+        {
+            words[idx].store(buf[idx], std::memory_order_relaxed);
+        }
+    }
+
+    std::atomic<uint64_t> seq;
+    std::atomic<Word> words[kWords];
+    Spinlock writer;
+};
+
+#endif // SEQLOCK_HPP__
@@ -1,18 +1,61 @@
 #ifndef SPAWN_TASK_HPP__
 #define SPAWN_TASK_HPP__
 
+#include <algorithm>
+#include <chrono>
 #include <future>
+#include <thread>
+#include <tuple>
 #include <type_traits>
+#include <utility>
+#include "threadpool.hpp"
+
+// The executor spawn_task() uses when none is given: an elastic ThreadPool,
+// created on first use, that keeps one worker per hardware thread and grows
+// once tasks have queued for 20ms, also when every worker is stuck waiting.
+// Tasks that block for long, including a spawned task waiting on the future
+// of another, should say so with a ThreadPool::BlockingScope so that the
+// pool adds a worker right away:
+//
+//     auto child = spawn_task(work);
+//     ThreadPool::BlockingScope blocking(spawn_task_executor());
+//     return child.get();
+inline ThreadPool & spawn_task_executor()
+{
+    // Never destroyed: like the detached threads spawn_task() used to create,
+    // tasks still running at exit do not hold up shutdown.
+    static ThreadPool * pool = []()
+    {
+        ThreadPool::ElasticOptions options;
+        options.min_threads = std::max(1u, std::thread::hardware_concurrency());
+        options.max_threads = std::max(64u, 4 * options.min_threads);
+        options.grow_after = std::chrono::milliseconds(20);
+        return new ThreadPool(options);
+    }();
+    return *pool;
+}
+
+// Result of spawn_task(func, args...): func and args are decay-copied and
+// the copies are called as rvalues.
+template<typename Func, typename ... Args>
+using spawn_result_t = std::invoke_result_t<std::decay_t<Func>, std::decay_t<Args>...>;
+
+// Runs func(args...) on executor. As with std::thread, func and args are
+// decay-copied and the arguments are passed as rvalues.
+template<typename Func, typename ... Args>
+std::future<spawn_result_t<Func, Args...>> spawn_task(ThreadPool & executor, Func && func, Args && ... args)
+{
+    return executor.execute([func = std::forward<Func>(func),
+                             args = std::make_tuple(std::forward<Args>(args)...)]() mutable -> decltype(auto)
+    {
+        return std::apply(std::move(func), std::move(args));
+    });
+}
 
 template<typename Func, typename ... Args>
-std::future<std::result_of_t<Func(Args...)>> spawn_task(Func && func, Args && ... args)
+std::future<spawn_result_t<Func, Args...>> spawn_task(Func && func, Args && ... args)
 {
-    using result_type = std::result_of_t<Func(Args...)>;
-    std::packaged_task<result_type(Args && ...)> task(std::move(func));
-    std::future<result_type> fut(task.get_future());
-    std::thread thr(std::move(task), std::move(args)...);
-    thr.detach();
-    return fut;
+    return spawn_task(spawn_task_executor(), std::forward<Func>(func), std::forward<Args>(args)...);
 }
 
 #endif // SPAWN_TASK_HPP__
\ No newline at end of file
@@ -2,12 +2,19 @@
 #define SPINLOCK_HPP__
 
 #include <atomic>
+#include <cstdint>
+#include "cpu_relax.hpp"
+#include "futex.hpp"
 
-class Spinlock
+// Test-and-test-and-set lock. Waiters spin on a plain load, which stays in
+// their own cache, and only retry the exchange once the lock looks free,
+// backing off exponentially between attempts. Aligned to a cache line so that
+// neighbouring data does not share the line the waiters spin on.
+class alignas(64) Spinlock
 {
 public:
     Spinlock() :
-        flag { ATOMIC_FLAG_INIT }
+        locked { false }
         {}
 
     Spinlock(const Spinlock & rhs) = delete;
@@ -16,16 +23,88 @@ public:
 
     void lock()
     {
-        while(flag.test_and_set(std::memory_order_acquire));
+        SpinBackoff backoff;
+        while(locked.exchange(true, std::memory_order_acquire))
+        {
+            do
+            {
+                backoff.pause();
+            } while(locked.load(std::memory_order_relaxed));
+        }
+    }
+
+    bool try_lock()
+    {
+        return !locked.load(std::memory_order_relaxed) && !locked.exchange(true, std::memory_order_acquire);
     }
 
     void unlock()
     {
-        flag.clear(std::memory_order_release);
+        locked.store(false, std::memory_order_release);
     }
 
 private:
-    std::atomic_flag flag;
+    std::atomic<bool> locked;
+};
+
+// Spins like Spinlock for a short while, then sleeps on a futex, so a waiter
+// behind a long critical section (or a preempted holder) does not burn a
+// core. unlock() only enters the kernel when someone may be asleep.
+class alignas(64) AdaptiveSpinlock
+{
+public:
+    AdaptiveSpinlock() :
+        state { UNLOCKED }
+        {}
+
+    AdaptiveSpinlock(const AdaptiveSpinlock & rhs) = delete;
+
+    AdaptiveSpinlock & operator=(const AdaptiveSpinlock & rhs) = delete;
+
+    void lock()
+    {
+        if(try_lock())
+        {
+            return;
+        }
+        for(SpinBackoff backoff; !backoff.spun_out(); backoff.pause())
+        {
+            if(state.load(std::memory_order_relaxed) == UNLOCKED && try_lock())
+            {
+                return;
+            }
+        }
+        // From here on the lock is always taken as CONTENDED: we cannot tell
+        // whether other sleepers remain, so the next unlock() must wake one.
+        while(state.exchange(CONTENDED, std::memory_order_acquire) != UNLOCKED)
+        {
+            futex_wait(state, CONTENDED);
+        }
+    }
+
+    bool try_lock()
+    {
+        uint32_t expected = UNLOCKED;
+        return state.compare_exchange_strong(expected, LOCKED, std::memory_order_acquire, std::memory_order_relaxed);
+    }
+
+    void unlock()
+    {
+        if(state.exchange(UNLOCKED, std::memory_order_release) == CONTENDED)
+        {
+            futex_wake(state, 1);
+        }
+    }
+
+private:
+    enum : uint32_t
+    {
+        UNLOCKED,
+        LOCKED,
+        CONTENDED // locked, and waiters may be asleep
+    };
+
+    std::atomic<uint32_t> state;
 };
 
 #endif // SPINLOCK_HPP__
\ No newline at end of file
@@ -0,0 +1,270 @@
+#ifndef _SPSC_RING_QUEUE_H_
+#define _SPSC_RING_QUEUE_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <iterator>
+#include <new>
+#include <thread>
+#include <utility>
+
+#include "event_count.hpp"
+
+// Wait-free bounded queue for exactly one producer thread and one consumer
+// thread. Each side owns one index and only reads the other's, through a
+// private copy that is refreshed when the ring looks full (producer) or
+// empty (consumer); so while the ring is neither, the two threads touch no
+// shared line except the slots themselves. The producer's and consumer's
+// data sit on separate cache lines.
+//
+// The batch calls move as many items as fit and publish them with a single
+// store. The capacity is cap rounded up to a power of two.
+template<typename T>
+class SpscRingQueue {
+public:
+	explicit SpscRingQueue(unsigned int cap) :
+		mask_(RoundUp(cap) - 1),
+		slots_(new Slot[mask_ + 1]),
+		tail_(0),
+		head_cache_(0),
+		head_(0),
+		tail_cache_(0) {
+	}
+
+	SpscRingQueue(const SpscRingQueue&) = delete;
+	SpscRingQueue& operator=(const SpscRingQueue&) = delete;
+	SpscRingQueue(SpscRingQueue&&) = delete;
+	SpscRingQueue& operator=(SpscRingQueue&&) = delete;
+
+	// Producer side.
+
+	template<typename... Args>
+	bool TryEmplace(Args&&... args) {
+		const size_t tail = tail_.load(std::memory_order_relaxed);
+		if (tail - head_cache_ > mask_) {
+			head_cache_ = head_.load(std::memory_order_acquire);
+			if (tail - head_cache_ > mask_) {
+				return false;
+			}
+		}
+		new (slots_[tail & mask_].storage) T(std::forward<Args>(args)...);
+		tail_.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool TryPush(T&& val) { return TryEmplace(std::move(val)); }
+
+	bool TryPush(const T& val) { return TryEmplace(val); }
+
+	// Moves up to count items from first; returns how many.
+	template<typename InputIt>
+	size_t TryPushBatch(InputIt first, size_t count) {
+		const size_t tail = tail_.load(std::memory_order_relaxed);
+		if (mask_ + 1 - (tail - head_cache_) < count) {
+			head_cache_ = head_.load(std::memory_order_acquire);
+		}
+		const size_t pushed = std::min(count, mask_ + 1 - (tail - head_cache_));
+		for (size_t idx = 0; idx < pushed; ++idx, ++first) {
+			new (slots_[(tail + idx) & mask_].storage) T(std::move(*first));
+		}
+		if (pushed != 0) {
+			tail_.store(tail + pushed, std::memory_order_release);
+		}
+		return pushed;
+	}
+
+	// Consumer side.
+
+	bool TryGetFront(T *val) {
+		const size_t head = head_.load(std::memory_order_relaxed);
+		if (head == tail_cache_) {
+			tail_cache_ = tail_.load(std::memory_order_acquire);
+			if (head == tail_cache_) {
+				return false;
+			}
+		}
+		T* const item = slots_[head & mask_].value();
+		*val = std::move(*item);
+		item->~T();
+		head_.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Moves up to count items to out; returns how many.
+	template<typename OutputIt>
+	size_t TryPopBatch(OutputIt out, size_t count) {
+		const size_t head = head_.load(std::memory_order_relaxed);
+		if (tail_cache_ - head < count) {
+			tail_cache_ = tail_.load(std::memory_order_acquire);
+		}
+		const size_t popped = std::min(count, tail_cache_ - head);
+		for (size_t idx = 0; idx < popped; ++idx, ++out) {
+			T* const item = slots_[(head + idx) & mask_].value();
+			*out = std::move(*item);
+			item->~T();
+		}
+		if (popped != 0) {
+			head_.store(head + popped, std::memory_order_release);
+		}
+		return popped;
+	}
+
+	// Either side; approximate while the other side is running.
+	int Size() const {
+		const size_t head = head_.load(std::memory_order_acquire);
+		return static_cast<int>(tail_.load(std::memory_order_acquire) - head);
+	}
+
+	bool IsEmpty() const { return Size() == 0; }
+
+	size_t Capacity() const { return mask_ + 1; }
+
+	~SpscRingQueue() noexcept {
+		const size_t tail = tail_.load(std::memory_order_relaxed);
+		for (size_t pos = head_.load(std::memory_order_relaxed); pos != tail; ++pos) {
+			slots_[pos & mask_].value()->~T();
+		}
+		delete[] slots_;
+	}
+
+private:
+	struct Slot {
+		T* value() { return std::launder(reinterpret_cast<T*>(storage)); }
+
+		alignas(T) unsigned char storage[sizeof(T)];
+	};
+
+	static size_t RoundUp(unsigned int cap) {
+		size_t size = 1;
+		while (size < cap) {
+			size <<= 1;
+		}
+		return size;
+	}
+
+	const size_t mask_;
+	Slot* const slots_;
+	// Written by the producer.
+	alignas(64) std::atomic<size_t> tail_;
+	size_t head_cache_;
+	// Written by the consumer.
+	alignas(64) std::atomic<size_t> head_;
+	size_t tail_cache_;
+};
+
+// SpscRingQueue with BoundedBufferQueue's blocking Push/GetFront, for when
+// either side has nothing better to do than wait. Each call costs a fence
+// on top of the ring operation, and a futex wake only if the other side is
+// asleep. PushBatch blocks until the whole batch has gone through, with at
+// most one wakeup per ring-full.
+template<typename T>
+class BlockingSpscQueue {
+public:
+	explicit BlockingSpscQueue(unsigned int cap) :
+		ring_(cap),
+		stop_(false),
+		push_counter_(0),
+		get_counter_(0) {
+	}
+
+	BlockingSpscQueue(const BlockingSpscQueue&) = delete;
+	BlockingSpscQueue& operator=(const BlockingSpscQueue&) = delete;
+	BlockingSpscQueue(BlockingSpscQueue&&) = delete;
+	BlockingSpscQueue& operator=(BlockingSpscQueue&&) = delete;
+
+	// Drops val once the queue is being destroyed.
+	void Push(T val) {
+		++push_counter_;
+		not_full_.wait([&]() { return Stopped() || TryPush(std::move(val)); });
+		push_counter_.fetch_sub(1, std::memory_order_release);
+	}
+
+	template<typename ForwardIt>
+	void PushBatch(ForwardIt first, size_t count) {
+		++push_counter_;
+		while (count != 0) {
+			size_t pushed = 0;
+			not_full_.wait([&]() { return Stopped() || (pushed = TryPushBatch(first, count)) != 0; });
+			if (pushed == 0) {
+				break;
+			}
+			std::advance(first, pushed);
+			count -= pushed;
+		}
+		push_counter_.fetch_sub(1, std::memory_order_release);
+	}
+
+	// Returns without a value once the queue is being destroyed.
+	void GetFront(T *val) {
+		++get_counter_;
+		not_empty_.wait([&]() { return Stopped() || TryGetFront(val); });
+		get_counter_.fetch_sub(1, std::memory_order_release);
+	}
+
+	// Waits for at least one item, then takes up to count; returns how many.
+	template<typename OutputIt>
+	size_t PopBatch(OutputIt out, size_t count) {
+		++get_counter_;
+		size_t popped = 0;
+		not_empty_.wait([&]() { return Stopped() || (popped = TryPopBatch(out, count)) != 0; });
+		get_counter_.fetch_sub(1, std::memory_order_release);
+		return popped;
+	}
+
+	// The non-blocking calls wake the other side if it is asleep. As with
+	// the ring, val is only moved from on success.
+	bool TryPush(T&& val) { return Published(ring_.TryPush(std::move(val)), not_empty_); }
+
+	bool TryPush(const T& val) { return Published(ring_.TryPush(val), not_empty_); }
+
+	template<typename InputIt>
+	size_t TryPushBatch(InputIt first, size_t count) {
+		return Published(ring_.TryPushBatch(first, count), not_empty_);
+	}
+
+	bool TryGetFront(T *val) { return Published(ring_.TryGetFront(val), not_full_); }
+
+	template<typename OutputIt>
+	size_t TryPopBatch(OutputIt out, size_t count) {
+		return Published(ring_.TryPopBatch(out, count), not_full_);
+	}
+
+	bool IsEmpty() const { return ring_.IsEmpty(); }
+
+	int Size() const { return ring_.Size(); }
+
+	// Releases a blocked caller on either side and waits until it has left,
+	// whether it was asleep or still spinning.
+	~BlockingSpscQueue() noexcept {
+		stop_.store(true);
+		not_empty_.notify_all();
+		not_full_.notify_all();
+		while (push_counter_.load() > 0 || get_counter_.load() > 0) {
+			std::this_thread::yield();
+		}
+	}
+
+private:
+	bool Stopped() const { return stop_.load(std::memory_order_relaxed); }
+
+	// Waking the other side happens only on success: a call that returns
+	// because the queue is being destroyed must not touch it again.
+	template<typename Count>
+	static Count Published(Count moved, EventCount& other_side) {
+		if (moved) {
+			other_side.notify_one();
+		}
+		return moved;
+	}
+
+	SpscRingQueue<T> ring_;
+	std::atomic<bool> stop_;
+	// Each written by one side only, so on lines of their own.
+	alignas(64) std::atomic<int> push_counter_;  // producer inside a blocking call
+	alignas(64) std::atomic<int> get_counter_;   // consumer inside a blocking call
+	EventCount not_empty_;  // the consumer sleeps here
+	EventCount not_full_;   // the producer sleeps here
+};
+
+#endif // _SPSC_RING_QUEUE_H_
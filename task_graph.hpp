@@ -0,0 +1,165 @@
+#ifndef TASK_GRAPH_HPP__
+#define TASK_GRAPH_HPP__
+
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+#include "continuation.hpp"
+#include "macro.h"
+#include "threadpool.hpp"
+
+// DAG of nullary tasks run on a ThreadPool. A task is posted the moment its
+// last predecessor finishes; no thread ever waits for a dependency. When a
+// task finishes and several successors become ready, the finishing worker
+// runs one of them itself and posts the rest.
+//
+//     TaskGraph graph;
+//     auto load = graph.add([&]() { ... });
+//     auto parse = graph.add([&]() { ... });
+//     graph.precede(load, parse);
+//     graph.run(pool).get();
+class TaskGraph {
+public:
+    using TaskId = size_t;
+
+    TaskGraph() = default;
+
+    DISALLOW_COPY_AND_ASSIGN(TaskGraph);
+
+    template <typename Func>
+    TaskId add(Func func) {
+        nodes->push_back(Node { std::function<void()>(std::move(func)), {}, 0 });
+        return nodes->size() - 1;
+    }
+
+    // after may only start once before has finished.
+    void precede(TaskId before, TaskId after) {
+        if(before >= nodes->size() || after >= nodes->size() || before == after) {
+            throw std::invalid_argument("TaskGraph::precede: bad task id");
+        }
+        (*nodes)[before].successors.push_back(after);
+        ++(*nodes)[after].predecessors;
+    }
+
+    size_t size() const { return nodes->size(); }
+
+    // Starts every task whose predecessors are done and returns a future that
+    // is ready once all tasks have run. After a task throws, tasks that have
+    // not started yet are skipped and the first exception is delivered
+    // through the future. Throws std::invalid_argument if the graph has a
+    // cycle. The graph must not be modified while a run is in progress; it
+    // may be destroyed, and it may be run again.
+    Future<void> run(ThreadPool& pool) const {
+        check_acyclic();
+        auto state = std::make_shared<RunState>(nodes, pool);
+        Future<void> done = state->promise.get_future();
+        if(nodes->empty()) {
+            state->promise.set_value();
+            return done;
+        }
+        for(TaskId id = 0; id < nodes->size(); ++id) {
+            if((*nodes)[id].predecessors == 0) {
+                state->schedule(state, id);
+            }
+        }
+        return done;
+    }
+
+private:
+    struct Node {
+        std::function<void()> func;
+        std::vector<TaskId> successors;
+        size_t predecessors;
+    };
+
+    using NodeList = std::vector<Node>;
+
+    struct RunState {
+        std::shared_ptr<const NodeList> nodes;
+        ThreadPool& pool;
+        std::unique_ptr<std::atomic<size_t>[]> waiting; // unfinished predecessors per task
+        std::atomic<size_t> remaining;
+        std::atomic<bool> failed { false };
+        std::exception_ptr error;
+        Promise<void> promise;
+
+        RunState(std::shared_ptr<const NodeList> nodes, ThreadPool& pool) :
+            nodes { std::move(nodes) },
+            pool { pool },
+            waiting { new std::atomic<size_t>[this->nodes->size()] },
+            remaining { this->nodes->size() } {
+            for(size_t ii = 0; ii < this->nodes->size(); ++ii) {
+                waiting[ii] = (*this->nodes)[ii].predecessors;
+            }
+        }
+
+        void schedule(const std::shared_ptr<RunState>& self, TaskId id) {
+            pool.post([self, id]() { self->execute(self, id); });
+        }
+
+        void execute(const std::shared_ptr<RunState>& self, TaskId id) {
+            for(;;) {
+                const Node& node = (*nodes)[id];
+                if(!failed.load(std::memory_order_acquire)) {
+                    try {
+                        node.func();
+                    } catch(...) {
+                        if(!failed.exchange(true)) { error = std::current_exception(); }
+                    }
+                }
+
+                // Run the first successor that became ready here, post the rest.
+                TaskId next = node.successors.size();
+                bool have_next = false;
+                for(TaskId succ : node.successors) {
+                    if(waiting[succ].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                        if(have_next) {
+                            schedule(self, succ);
+                        } else {
+                            next = succ;
+                            have_next = true;
+                        }
+                    }
+                }
+                if(remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    if(error) {
+                        promise.set_exception(error);
+                    } else {
+                        promise.set_value();
+                    }
+                    return;
+                }
+                if(!have_next) { return; }
+                id = next;
+            }
+        }
+    };
+
+    void check_acyclic() const {
+        std::vector<size_t> indegree(nodes->size());
+        std::vector<TaskId> ready;
+        for(TaskId id = 0; id < nodes->size(); ++id) {
+            indegree[id] = (*nodes)[id].predecessors;
+            if(indegree[id] == 0) { ready.push_back(id); }
+        }
+        size_t visited = 0;
+        while(!ready.empty()) {
+            const TaskId id = ready.back();
+            ready.pop_back();
+            ++visited;
+            for(TaskId succ : (*nodes)[id].successors) {
+                if(--indegree[succ] == 0) { ready.push_back(succ); }
+            }
+        }
+        if(visited != nodes->size()) {
+            throw std::invalid_argument("TaskGraph::run: graph has a cycle");
+        }
+    }
+
+    std::shared_ptr<NodeList> nodes = std::make_shared<NodeList>();
+};
+
+#endif // TASK_GRAPH_HPP__
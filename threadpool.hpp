@@ -1,72 +1,1062 @@
 #ifndef _THREADPOOL_H_
 #define _THREADPOOL_H_
 
+#include <algorithm>
 #include <atomic>
 #include <cassert>
+#include <chrono>
 #include <condition_variable>
+#include <deque>
 #include <functional>
 #include <future>
+#include <iterator>
 #include <memory>
 #include <mutex>
-#include <queue>
+#include <stdexcept>
 #include <string>
 #include <thread>
+#include <tuple>
+#include <type_traits>
 #include <vector>
+#include "block_pool.hpp"
+#include "cpu_relax.hpp"
+#include "cpu_topology.hpp"
+#include "function_wrapper.hpp"
+#include "latency_histogram.hpp"
 #include "macro.h"
 
 class ThreadPool
 {
 public:
-    DISALLOW_COPY_AND_ASSIGN(ThreadPool);
+    // SHARED_QUEUE: every worker pops from one set of mutex-protected lanes.
+    // WORK_STEALING: every worker owns a deque; tasks submitted from a worker
+    // go to its own deque, and idle workers steal from the others.
+    enum class SchedulePolicy
+    {
+        SHARED_QUEUE,
+        WORK_STEALING
+    };
 
-    ThreadPool(unsigned size) :
-        stop { false } {
-        for(size_t ii = 0; ii < size; ++ii) {
-            threads.emplace_back
-            (
-                [&]() {
-                    for(;;) {
-                        std::unique_lock<std::mutex> lck(mtx);
-                        cv.wait(lck, [&]{ return stop || !tasks.empty(); });
-                        if(stop && tasks.empty()) { return; }
-                        auto task = std::move(tasks.front()); tasks.pop();
-                        lck.unlock();
-                        task();
-                    }
-                }
-            );
+    // Submission lanes. Workers drain a higher lane before a lower one. A
+    // NORMAL or BACKGROUND task that has waited longer than its lane's aging
+    // limit (see set_aging()) is promoted to run right after CRITICAL work, so
+    // background work keeps moving under sustained load. Tasks submitted with
+    // a deadline are served earliest-deadline-first, after CRITICAL and aged
+    // tasks and before NORMAL.
+    enum class Priority
+    {
+        CRITICAL,
+        NORMAL,
+        BACKGROUND
+    };
+
+    using Clock = std::chrono::steady_clock;
+
+    // Where workers run (Linux sched_setaffinity). NONE leaves it to the OS.
+    // COMPACT and SCATTER pin worker i to one CPU of
+    // CpuTopology::compact_order() / scatter_order(). EXPLICIT pins worker i
+    // to cpus[i % cpus.size()]. CPU_SET lets every worker float over cpus,
+    // e.g. the CPUs of one NUMA node. Pinning is best effort: a CPU outside
+    // the process's affinity mask leaves that worker unpinned.
+    enum class PlacementPolicy
+    {
+        NONE,
+        COMPACT,
+        SCATTER,
+        EXPLICIT,
+        CPU_SET
+    };
+
+    struct Placement
+    {
+        PlacementPolicy policy;
+        std::vector<int> cpus;
+
+        Placement() : policy { PlacementPolicy::NONE } {}
+
+        Placement(PlacementPolicy policy, std::vector<int> cpus = std::vector<int>()) :
+            policy { policy },
+            cpus { std::move(cpus) }
+            {}
+    };
+
+    // Sizing of an elastic pool (SHARED_QUEUE only). The pool starts with
+    // min_threads workers. While no worker is idle it adds one, up to
+    // max_threads, whenever the oldest queued task has waited longer than
+    // grow_after, or when queued work finds fewer than min_threads workers
+    // that are not inside a BlockingScope. A worker above min_threads that
+    // stays idle for idle_timeout exits. Growth is checked on every submission,
+    // dequeue and BlockingScope entry, and by a supervisor thread every
+    // grow_after while tasks are queued below max_threads, so the pool also
+    // grows when all its workers are stuck in tasks and nobody submits.
+    struct ElasticOptions
+    {
+        unsigned min_threads = 1;
+        unsigned max_threads = std::max(1u, std::thread::hardware_concurrency());
+        Clock::duration grow_after = std::chrono::milliseconds(1);
+        Clock::duration idle_timeout = std::chrono::seconds(10);
+    };
+
+    // How an idle worker waits before it parks on the condition variable:
+    // spin_count polls for work separated by a pause instruction, then
+    // yield_count polls separated by std::this_thread::yield(). A submitter
+    // does not wake a parked worker for a task that a spinning one will take,
+    // so spinning trades CPU time for skipping the futex wake and context
+    // switch. The default parks right away.
+    struct IdleStrategy
+    {
+        unsigned spin_count = 0;
+        unsigned yield_count = 0;
+    };
+
+    // Per-worker counters; times are in nanoseconds. They are only collected
+    // when the pool is compiled with THREADPOOL_ENABLE_STATS defined, and
+    // otherwise stay zero at no cost.
+    struct WorkerStats
+    {
+        uint64_t tasks = 0;
+        uint64_t busy_ns = 0; // running tasks
+        uint64_t idle_ns = 0; // spinning or parked, waiting for work
+        LatencyHistogram::Snapshot queue_wait; // enqueue to dequeue
+        LatencyHistogram::Snapshot run_time;
+        LatencyHistogram::Snapshot queue_depth; // queued tasks seen at each dequeue
+
+        void merge(const WorkerStats& rhs) {
+            tasks += rhs.tasks;
+            busy_ns += rhs.busy_ns;
+            idle_ns += rhs.idle_ns;
+            queue_wait.merge(rhs.queue_wait);
+            run_time.merge(rhs.run_time);
+            queue_depth.merge(rhs.queue_depth);
+        }
+    };
+
+    struct Stats
+    {
+        bool enabled = false;
+        long queued = 0; // tasks waiting right now, across all queues
+        std::vector<WorkerStats> workers; // one per worker slot; a retired slot is reused
+        WorkerStats callers; // tasks run by other threads through run_pending_task()
+
+        WorkerStats total() const {
+            WorkerStats sum = callers;
+            for(const auto& worker : workers) { sum.merge(worker); }
+            return sum;
         }
+    };
+
+    static constexpr bool stats_enabled() {
+#ifdef THREADPOOL_ENABLE_STATS
+        return true;
+#else
+        return false;
+#endif
     }
 
+    // Declares that the current pool task is about to block (I/O, waiting on
+    // another future, ...). While it lives, an elastic pool does not count the
+    // worker as available and may start a replacement for it.
+    class BlockingScope
+    {
+    public:
+        DISALLOW_COPY_AND_ASSIGN(BlockingScope);
+
+        explicit BlockingScope(ThreadPool& pool) :
+            pool { pool } {
+            pool.enter_blocking();
+        }
+
+        ~BlockingScope() noexcept { pool.leave_blocking(); }
+
+    private:
+        ThreadPool& pool;
+    };
+
+    DISALLOW_COPY_AND_ASSIGN(ThreadPool);
+
+    ThreadPool(unsigned size, SchedulePolicy policy = SchedulePolicy::SHARED_QUEUE,
+               const Placement& placement = Placement()) :
+        ThreadPool(policy, ElasticOptions { size, size }, false, placement) {}
+
+    explicit ThreadPool(const ElasticOptions& options, const Placement& placement = Placement()) :
+        ThreadPool(SchedulePolicy::SHARED_QUEUE, options, true, placement) {}
+
+    // The callable and its arguments are stored in the task closure itself,
+    // and both the closure and the future's shared state come from BlockPool.
     template <typename Func, typename ... Arg>
     auto execute(Func&& func, Arg&& ... arg) {
         using Ret = typename std::result_of<Func(Arg...)>::type;
-        auto task = std::make_shared<std::packaged_task<Ret()>> (
-                std::bind(std::forward<Func>(func), std::forward<Arg>(arg)...)
-            );
-        std::future<Ret> fut = task->get_future();
-        std::unique_lock<std::mutex> lck(mtx);
-        assert(!stop);
-        tasks.emplace([task]() { (*task)(); });
-        cv.notify_one();
+        std::future<Ret> fut;
+        enqueue(package(fut, bind_call(std::forward<Func>(func), std::forward<Arg>(arg)...)));
+        return fut;
+    }
+
+    template <typename Func, typename ... Arg>
+    auto execute(Priority priority, Func&& func, Arg&& ... arg) {
+        using Ret = typename std::result_of<Func(Arg...)>::type;
+        std::future<Ret> fut;
+        enqueue_lane(lane_index(priority),
+            package(fut, bind_call(std::forward<Func>(func), std::forward<Arg>(arg)...)));
+        return fut;
+    }
+
+    // A missed deadline does not drop the task; it still runs, and the miss
+    // is counted in missed_deadline_count().
+    template <typename Func, typename ... Arg>
+    auto execute(Clock::time_point deadline, Func&& func, Arg&& ... arg) {
+        using Ret = typename std::result_of<Func(Arg...)>::type;
+        std::future<Ret> fut;
+        enqueue_lane(DEADLINE_LANE,
+            package(fut, bind_call(std::forward<Func>(func), std::forward<Arg>(arg)...)), deadline);
+        return fut;
+    }
+
+    // Fire-and-forget submission: no future, no shared state. An exception
+    // escaping a posted task terminates the program, as with std::thread.
+    template <typename Func, typename ... Arg>
+    void post(Func&& func, Arg&& ... arg) {
+        enqueue(Task(bind_call(std::forward<Func>(func), std::forward<Arg>(arg)...)));
+    }
+
+    template <typename Func, typename ... Arg>
+    void post(Priority priority, Func&& func, Arg&& ... arg) {
+        enqueue_lane(lane_index(priority),
+            Task(bind_call(std::forward<Func>(func), std::forward<Arg>(arg)...)));
+    }
+
+    // Submits every nullary callable in [first, last) with a single queue
+    // lock acquisition and wakes no more workers than there are tasks. The
+    // callables are moved from; the range is walked once, so input iterators
+    // will do. Returns one future per task.
+    template <typename It>
+    auto execute_bulk(It first, It last) {
+        using Func = typename std::iterator_traits<It>::value_type;
+        using Ret = typename std::result_of<Func&()>::type;
+        std::vector<std::future<Ret>> futs;
+        std::vector<Task> batch;
+        const size_t hint = batch_size_hint(first, last);
+        futs.reserve(hint);
+        batch.reserve(hint);
+        for(; first != last; ++first) {
+            futs.emplace_back();
+            batch.push_back(package(futs.back(), std::move(*first)));
+        }
+        enqueue_bulk(batch);
+        return futs;
+    }
+
+    // Like execute_bulk(), but returns a single future that becomes ready once
+    // every task has finished. If any task throws, the first exception is
+    // delivered through it after the whole batch has run.
+    template <typename It>
+    std::future<void> post_batch(It first, It last) {
+        struct Completion
+        {
+            std::atomic<size_t> remaining;
+            std::atomic<bool> failed { false };
+            std::exception_ptr error;
+            std::promise<void> promise;
+        };
+
+        auto done = std::make_shared<Completion>();
+        std::future<void> fut = done->promise.get_future();
+        std::vector<Task> batch;
+        batch.reserve(batch_size_hint(first, last));
+        for(; first != last; ++first) {
+            batch.emplace_back([done, func = std::move(*first)]() mutable {
+                try {
+                    func();
+                } catch(...) {
+                    if(!done->failed.exchange(true)) { done->error = std::current_exception(); }
+                }
+                if(done->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    if(done->error) {
+                        done->promise.set_exception(done->error);
+                    } else {
+                        done->promise.set_value();
+                    }
+                }
+            });
+        }
+        // Nothing has been queued yet, so no task can see remaining early.
+        done->remaining = batch.size();
+        if(batch.empty()) {
+            done->promise.set_value();
+            return fut;
+        }
+        enqueue_bulk(batch);
         return fut;
     }
 
+    // Runs one queued task on the calling thread if there is one, so a thread
+    // waiting for pool work can help instead of blocking.
+    // A task run this way by a worker of this pool counts towards that
+    // worker's stats, and its run time is also part of the outer task's.
+    bool run_pending_task() {
+        StampedTask item;
+        if(policy == SchedulePolicy::SHARED_QUEUE) {
+            std::unique_lock<std::mutex> lck(mtx);
+            if(!pop_lane(item, false)) { return false; }
+            --pending;
+        } else {
+            if(!next_task_stealing(local_pool == this ? int(local_index) : -1, item)) { return false; }
+            --pending;
+        }
+        run_task(item, local_pool == this ? local_counters : caller_counters.get());
+        return true;
+    }
+
+    // Sets how long the oldest task of a lane may wait before it is served
+    // ahead of higher lanes. Defaults: NORMAL 20ms, BACKGROUND 200ms,
+    // CRITICAL never ages.
+    void set_aging(Priority priority, Clock::duration limit) {
+        std::lock_guard<std::mutex> lck(mtx);
+        lanes[lane_index(priority)].aging = limit;
+    }
+
+    // Takes effect the next time a worker runs out of work.
+    void set_idle_strategy(const IdleStrategy& strategy) {
+        spin_count.store(strategy.spin_count, std::memory_order_relaxed);
+        yield_count.store(strategy.yield_count, std::memory_order_relaxed);
+    }
+
+    // Enqueue-to-dequeue latency in nanoseconds of the tasks taken from a
+    // lane so far. Under WORK_STEALING, plain execute()/post() tasks bypass
+    // the lanes and are not included.
+    LatencyHistogram::Snapshot queue_wait(Priority priority) const {
+        return lanes[lane_index(priority)].wait.snapshot();
+    }
+
+    LatencyHistogram::Snapshot deadline_queue_wait() const {
+        return lanes[DEADLINE_LANE].wait.snapshot();
+    }
+
+    // Deadline tasks that were dequeued after their deadline had passed.
+    uint64_t missed_deadline_count() const { return missed_deadlines.load(std::memory_order_relaxed); }
+
+    // Current number of workers; changes over time in an elastic pool.
+    unsigned size() const { return live.load(std::memory_order_relaxed); }
+
+    SchedulePolicy schedule_policy() const { return policy; }
+
+    // Cheap enough to scrape periodically: copies the per-worker histograms
+    // under the pool lock, which workers only contend for between tasks.
+    Stats stats() const {
+        Stats snap;
+        snap.enabled = stats_enabled();
+        snap.queued = pending.load(std::memory_order_relaxed);
+        if(caller_counters) { snap.callers = caller_counters->snapshot(); }
+        std::lock_guard<std::mutex> lck(mtx);
+        for(const auto& counters : worker_counters) {
+            snap.workers.push_back(counters->snapshot());
+        }
+        return snap;
+    }
+
     ~ThreadPool() noexcept {
-        stop = true;
+        {
+            std::lock_guard<std::mutex> lck(mtx);
+            stop = true;
+        }
         cv.notify_all();
+        if(supervisor.joinable()) {
+            supervisor_cv.notify_all();
+            supervisor.join();
+        }
         for(auto& thr : threads) {
             assert(thr.joinable());
             thr.join();
         }
     }
 
+private:
+    using Task = FunctionWrapper;
+
+    ThreadPool(SchedulePolicy policy, const ElasticOptions& options, bool elastic, const Placement& placement) :
+        stop { false },
+        policy { policy },
+        elastic { elastic },
+        options { options },
+        placement { resolve_placement(placement) },
+        live { 0 },
+        spawned { 0 },
+        blocked { 0 },
+        supervisor_idle { false },
+        sleepers { 0 },
+        spinners { 0 },
+        spin_count { 0 },
+        yield_count { 0 },
+        pending { 0 },
+        next_queue { 0 },
+        lane_count { 0 },
+        missed_deadlines { 0 } {
+        if(options.min_threads == 0) {
+            throw std::invalid_argument("ThreadPool: need at least one thread");
+        }
+        if(options.min_threads > options.max_threads) {
+            throw std::invalid_argument("ThreadPool: min_threads exceeds max_threads");
+        }
+        assert(!elastic || policy == SchedulePolicy::SHARED_QUEUE);
+        for(auto& lane : lanes) {
+            lane.aging = Clock::duration::max();
+        }
+        lanes[NORMAL_LANE].aging = std::chrono::milliseconds(20);
+        lanes[BACKGROUND_LANE].aging = std::chrono::milliseconds(200);
+        if(stats_enabled()) { caller_counters.reset(new WorkerCounters(true)); }
+        const unsigned size = options.min_threads;
+        if(policy == SchedulePolicy::WORK_STEALING) {
+            for(unsigned ii = 0; ii < size; ++ii) {
+                queues.emplace_back(new WorkStealingQueue());
+            }
+        }
+        std::lock_guard<std::mutex> lck(mtx);
+        for(unsigned ii = 0; ii < size; ++ii) {
+            if(policy == SchedulePolicy::SHARED_QUEUE) {
+                spawn_worker();
+            } else {
+                threads.emplace_back([this, ii, counters = claim_counters()]() {
+                    place_worker(ii);
+                    run_stealing(ii, counters);
+                });
+                ++live;
+                ++spawned;
+            }
+        }
+        if(elastic) {
+            supervisor = std::thread([this]() { supervise(); });
+        }
+    }
+
+    // Caller holds mtx.
+    void spawn_worker() {
+        threads.emplace_back([this, index = spawned++, counters = claim_counters()]() {
+            place_worker(index);
+            run_shared(counters);
+        });
+        ++live;
+    }
+
+    // Turns COMPACT and SCATTER into an explicit CPU order.
+    static Placement resolve_placement(const Placement& requested) {
+        Placement resolved = requested;
+        if(requested.policy == PlacementPolicy::COMPACT) {
+            resolved.cpus = CpuTopology::detect().compact_order();
+        } else if(requested.policy == PlacementPolicy::SCATTER) {
+            resolved.cpus = CpuTopology::detect().scatter_order();
+        }
+        return resolved;
+    }
+
+    void place_worker(unsigned index) const {
+        if(placement.policy == PlacementPolicy::NONE || placement.cpus.empty()) { return; }
+        if(placement.policy == PlacementPolicy::CPU_SET) {
+            CpuTopology::pin_current_thread(placement.cpus);
+        } else {
+            CpuTopology::pin_current_thread({ placement.cpus[index % placement.cpus.size()] });
+        }
+    }
+
+    // Caller holds mtx. Starts one more worker if queued work is not being
+    // picked up fast enough; see ElasticOptions.
+    void maybe_grow() {
+        if(!elastic || stop || pending == 0 || live >= options.max_threads) { return; }
+        wake_supervisor();
+        if(sleepers > 0 || spinners > 0) { return; }
+        bool grow = live < blocked + options.min_threads;
+        if(!grow) {
+            const auto now = Clock::now();
+            for(const auto& lane : lanes) {
+                if(!lane.queue.empty() && now - lane.queue.front().enqueued >= options.grow_after) {
+                    grow = true;
+                    break;
+                }
+            }
+        }
+        if(grow) { spawn_worker(); }
+    }
+
+    // Caller holds mtx. The exiting worker detaches its own std::thread; it
+    // touches nothing in the pool after mtx is released.
+    void retire() {
+        const auto id = std::this_thread::get_id();
+        auto it = std::find_if(threads.begin(), threads.end(),
+            [&](const std::thread& thr) { return thr.get_id() == id; });
+        assert(it != threads.end());
+        it->detach();
+        threads.erase(it);
+        --live;
+        if(elastic) { wake_supervisor(); }
+        if(local_counters) { free_counters.push_back(local_counters); }
+    }
+
+    // Elastic pools only. Re-checks growth every grow_after while tasks are
+    // queued, since a task can grow old without any submission, dequeue or
+    // BlockingScope to notice: when every worker waits on something the pool
+    // does not know about, say. Sleeps while the queue is empty or the pool
+    // is at max_threads; maybe_grow() and retire() wake it.
+    void supervise() {
+        std::unique_lock<std::mutex> lck(mtx);
+        while(!stop) {
+            if(pending == 0 || live >= options.max_threads) {
+                supervisor_idle = true;
+                supervisor_cv.wait(lck, [&]() { return stop || !supervisor_idle; });
+                supervisor_idle = false;
+                continue;
+            }
+            supervisor_cv.wait_for(lck, options.grow_after);
+            maybe_grow();
+        }
+    }
+
+    // Caller holds mtx.
+    void wake_supervisor() {
+        if(supervisor_idle) {
+            supervisor_idle = false;
+            supervisor_cv.notify_one();
+        }
+    }
+
+    void enter_blocking() {
+        std::lock_guard<std::mutex> lck(mtx);
+        ++blocked;
+        maybe_grow();
+    }
+
+    void leave_blocking() {
+        std::lock_guard<std::mutex> lck(mtx);
+        --blocked;
+    }
+
+    // Number of tasks in [first, last) if it can be counted without using up
+    // the range, which takes a forward iterator; 0 otherwise.
+    template <typename It>
+    static size_t batch_size_hint(It first, It last) {
+        using Category = typename std::iterator_traits<It>::iterator_category;
+        if constexpr (std::is_base_of<std::forward_iterator_tag, Category>::value) {
+            return static_cast<size_t>(std::distance(first, last));
+        } else {
+            return 0;
+        }
+    }
+
+    // Like std::bind: arguments are decay-copied (std::ref is unwrapped) and
+    // passed to the callable as lvalues.
+    template <typename Func, typename ... Arg>
+    static auto bind_call(Func&& func, Arg&& ... arg) {
+        return [func = std::forward<Func>(func),
+                args = std::make_tuple(std::forward<Arg>(arg)...)]() mutable -> decltype(auto) {
+            return std::apply(func, args);
+        };
+    }
+
+    template <typename Ret, typename Call>
+    static Task package(std::future<Ret>& fut, Call&& call) {
+        std::promise<Ret> promise(std::allocator_arg, PoolAllocator<char>());
+        fut = promise.get_future();
+        return Task([promise = std::move(promise), call = std::forward<Call>(call)]() mutable {
+            fulfill(promise, call);
+        });
+    }
+
+    template <typename Ret, typename Call>
+    static void fulfill(std::promise<Ret>& promise, Call& call) {
+        try {
+            if constexpr (std::is_void<Ret>::value) {
+                call();
+                promise.set_value();
+            } else {
+                promise.set_value(call());
+            }
+        } catch(...) {
+            promise.set_exception(std::current_exception());
+        }
+    }
+
+#ifdef THREADPOOL_ENABLE_STATS
+    using Stamp = Clock::time_point;
+
+    static Stamp stamp(Clock::time_point now = Clock::now()) { return now; }
+#else
+    struct Stamp {};
+
+    static Stamp stamp(Clock::time_point = Clock::time_point()) { return Stamp(); }
+#endif
+
+    static uint64_t nanos(Clock::duration dur) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(dur).count();
+    }
+
+    // A task plus its enqueue time, which is only kept with stats enabled.
+    struct StampedTask
+    {
+        Task task;
+        Stamp enqueued;
+    };
+
+    // Written by one worker (or, for caller_counters, by any thread) and read
+    // by stats(); aligned so that neighbouring workers never share a cache
+    // line.
+    struct alignas(64) WorkerCounters
+    {
+        const bool shared;
+        std::atomic<uint64_t> tasks { 0 };
+        std::atomic<uint64_t> busy_ns { 0 };
+        std::atomic<uint64_t> idle_ns { 0 };
+        LatencyHistogram queue_wait;
+        LatencyHistogram run_time;
+        LatencyHistogram queue_depth;
+
+        explicit WorkerCounters(bool shared) : shared { shared } {}
+
+        void record(LatencyHistogram& hist, uint64_t value) {
+            if(shared) {
+                hist.record(value);
+            } else {
+                hist.record_single_writer(value);
+            }
+        }
+
+        void add(std::atomic<uint64_t>& counter, uint64_t value) {
+            if(shared) {
+                counter.fetch_add(value, std::memory_order_relaxed);
+            } else {
+                counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+            }
+        }
+
+        WorkerStats snapshot() const {
+            WorkerStats snap;
+            snap.tasks = tasks.load(std::memory_order_relaxed);
+            snap.busy_ns = busy_ns.load(std::memory_order_relaxed);
+            snap.idle_ns = idle_ns.load(std::memory_order_relaxed);
+            snap.queue_wait = queue_wait.snapshot();
+            snap.run_time = run_time.snapshot();
+            snap.queue_depth = queue_depth.snapshot();
+            return snap;
+        }
+    };
+
+    // Caller holds mtx. Returns the counters for a new worker, reusing those
+    // of a retired one; nullptr with stats disabled.
+    WorkerCounters* claim_counters() {
+        if(!stats_enabled()) { return nullptr; }
+        if(!free_counters.empty()) {
+            WorkerCounters* counters = free_counters.back();
+            free_counters.pop_back();
+            return counters;
+        }
+        worker_counters.emplace_back(new WorkerCounters(false));
+        return worker_counters.back().get();
+    }
+
+    void run_task(StampedTask& item, WorkerCounters* counters) {
+#ifdef THREADPOOL_ENABLE_STATS
+        const auto start = Clock::now();
+        counters->record(counters->queue_wait, nanos(start - item.enqueued));
+        counters->record(counters->queue_depth, static_cast<uint64_t>(std::max(0L, pending.load(std::memory_order_relaxed))));
+        item.task();
+        const uint64_t run = nanos(Clock::now() - start);
+        counters->record(counters->run_time, run);
+        counters->add(counters->busy_ns, run);
+        counters->add(counters->tasks, 1);
+#else
+        (void)counters;
+        item.task();
+#endif
+        item.task = Task();
+    }
+
+    // Runs wait(); with stats enabled the time spent is added to the
+    // worker's idle time.
+    template <typename Wait>
+    auto wait_idle(WorkerCounters* counters, Wait wait) {
+#ifdef THREADPOOL_ENABLE_STATS
+        const auto start = Clock::now();
+        auto result = wait();
+        counters->add(counters->idle_ns, nanos(Clock::now() - start));
+        return result;
+#else
+        (void)counters;
+        return wait();
+#endif
+    }
+
+    // Lanes in service order. DEADLINE_LANE is kept as a min-heap on deadline.
+    enum LaneIndex
+    {
+        CRITICAL_LANE,
+        DEADLINE_LANE,
+        NORMAL_LANE,
+        BACKGROUND_LANE,
+        LANE_COUNT
+    };
+
+    struct QueuedTask
+    {
+        Task task;
+        Clock::time_point enqueued;
+        Clock::time_point deadline;
+    };
+
+    struct Lane
+    {
+        std::deque<QueuedTask> queue;
+        Clock::duration aging;
+        LatencyHistogram wait;
+    };
+
+    static LaneIndex lane_index(Priority priority) {
+        switch(priority) {
+            case Priority::CRITICAL: return CRITICAL_LANE;
+            case Priority::BACKGROUND: return BACKGROUND_LANE;
+            default: return NORMAL_LANE;
+        }
+    }
+
+    static bool later_deadline(const QueuedTask& lhs, const QueuedTask& rhs) {
+        return lhs.deadline > rhs.deadline;
+    }
+
+    // Caller holds mtx.
+    void push_lane(LaneIndex idx, Task task, Clock::time_point now,
+                   Clock::time_point deadline = Clock::time_point::max()) {
+        auto& queue = lanes[idx].queue;
+        queue.push_back(QueuedTask { std::move(task), now, deadline });
+        if(idx == DEADLINE_LANE) {
+            std::push_heap(queue.begin(), queue.end(), later_deadline);
+        }
+        ++lane_count;
+        ++pending;
+    }
+
+    // Caller holds mtx. With urgent_only, NORMAL and BACKGROUND tasks are only
+    // taken once they have aged; work-stealing workers use that to serve
+    // urgent lanes before their deques and the remaining lanes after them.
+    bool pop_lane(StampedTask& item, bool urgent_only) {
+        if(lane_count == 0) { return false; }
+        const auto now = Clock::now();
+        int pick = -1;
+        if(!lanes[CRITICAL_LANE].queue.empty()) {
+            pick = CRITICAL_LANE;
+        } else {
+            // Anti-starvation: the longest-waiting aged head goes first.
+            for(int idx : { NORMAL_LANE, BACKGROUND_LANE }) {
+                const auto& queue = lanes[idx].queue;
+                if(!queue.empty() && now - queue.front().enqueued >= lanes[idx].aging &&
+                   (pick < 0 || queue.front().enqueued < lanes[pick].queue.front().enqueued)) {
+                    pick = idx;
+                }
+            }
+            const int last = urgent_only ? DEADLINE_LANE : BACKGROUND_LANE;
+            for(int idx = DEADLINE_LANE; pick < 0 && idx <= last; ++idx) {
+                if(!lanes[idx].queue.empty()) { pick = idx; }
+            }
+        }
+        if(pick < 0) { return false; }
+
+        auto& queue = lanes[pick].queue;
+        if(pick == DEADLINE_LANE) {
+            std::pop_heap(queue.begin(), queue.end(), later_deadline);
+        }
+        QueuedTask& entry = pick == DEADLINE_LANE ? queue.back() : queue.front();
+        lanes[pick].wait.record(std::chrono::duration_cast<std::chrono::nanoseconds>(now - entry.enqueued).count());
+        if(pick == DEADLINE_LANE && now > entry.deadline) {
+            missed_deadlines.fetch_add(1, std::memory_order_relaxed);
+        }
+        item.task = std::move(entry.task);
+        item.enqueued = stamp(entry.enqueued);
+        if(pick == DEADLINE_LANE) {
+            queue.pop_back();
+        } else {
+            queue.pop_front();
+        }
+        --lane_count;
+        return true;
+    }
+
+    // Owner pushes and pops at the front (LIFO, cache-warm), thieves take the
+    // oldest task from the back.
+    struct alignas(64) WorkStealingQueue
+    {
+        std::mutex mtx;
+        std::deque<StampedTask> deq;
+
+        void push(Task task, Stamp now) {
+            std::lock_guard<std::mutex> lck(mtx);
+            deq.push_front(StampedTask { std::move(task), now });
+        }
+
+        template <typename It>
+        void push_bulk(It first, It last, Stamp now) {
+            std::lock_guard<std::mutex> lck(mtx);
+            for(; first != last; ++first) {
+                deq.push_front(StampedTask { std::move(*first), now });
+            }
+        }
+
+        bool try_pop(StampedTask& item) {
+            std::lock_guard<std::mutex> lck(mtx);
+            if(deq.empty()) { return false; }
+            item = std::move(deq.front()); deq.pop_front();
+            return true;
+        }
+
+        bool try_steal(StampedTask& item) {
+            std::lock_guard<std::mutex> lck(mtx);
+            if(deq.empty()) { return false; }
+            item = std::move(deq.back()); deq.pop_back();
+            return true;
+        }
+    };
+
+    void enqueue_lane(LaneIndex idx, Task task, Clock::time_point deadline = Clock::time_point::max()) {
+        std::lock_guard<std::mutex> lck(mtx);
+        assert(!stop);
+        push_lane(idx, std::move(task), Clock::now(), deadline);
+        wake_for(1);
+        maybe_grow();
+    }
+
+    void enqueue(Task task) {
+        if(policy == SchedulePolicy::SHARED_QUEUE) {
+            enqueue_lane(NORMAL_LANE, std::move(task));
+            return;
+        }
+
+        assert(!stop);
+        const unsigned index = local_pool == this ?
+            local_index : next_queue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+        // Count the task before it becomes visible, so a worker that takes it
+        // never drives pending below zero.
+        ++pending;
+        queues[index]->push(std::move(task), stamp());
+        if(sleepers > 0 && pending > spinners) {
+            std::lock_guard<std::mutex> lck(mtx);
+            cv.notify_one();
+        }
+    }
+
+    void enqueue_bulk(std::vector<Task>& batch) {
+        if(batch.empty()) { return; }
+
+        if(policy == SchedulePolicy::SHARED_QUEUE) {
+            std::unique_lock<std::mutex> lck(mtx);
+            assert(!stop);
+            const auto now = Clock::now();
+            for(auto& task : batch) {
+                push_lane(NORMAL_LANE, std::move(task), now);
+            }
+            wake_for(batch.size());
+            maybe_grow();
+            return;
+        }
+
+        assert(!stop);
+        pending += static_cast<long>(batch.size());
+        if(local_pool == this) {
+            // Peers steal from the back of this deque as they run dry.
+            queues[local_index]->push_bulk(batch.begin(), batch.end(), stamp());
+        } else {
+            // One contiguous slice per deque, starting at the round-robin cursor.
+            const size_t nqueues = queues.size();
+            const size_t chunk = (batch.size() + nqueues - 1) / nqueues;
+            size_t index = next_queue.fetch_add(1, std::memory_order_relaxed);
+            const Stamp now = stamp();
+            for(size_t begin = 0; begin < batch.size(); begin += chunk, ++index) {
+                const size_t end = std::min(begin + chunk, batch.size());
+                queues[index % nqueues]->push_bulk(batch.begin() + begin, batch.begin() + end, now);
+            }
+        }
+        if(sleepers > 0) {
+            std::lock_guard<std::mutex> lck(mtx);
+            wake_for(batch.size());
+        }
+    }
+
+    // Wakes up to n parked workers. Caller holds mtx.
+    void wake(size_t n) {
+        const size_t parked = static_cast<size_t>(sleepers.load());
+        if(n >= parked) {
+            cv.notify_all();
+            return;
+        }
+        for(size_t ii = 0; ii < n; ++ii) {
+            cv.notify_one();
+        }
+    }
+
+    // Wakes parked workers for n new tasks, except for the tasks that
+    // spinning workers will pick up themselves. Caller holds mtx.
+    void wake_for(size_t n) {
+        const long unclaimed = pending.load() - spinners.load();
+        if(unclaimed > 0) { wake(std::min(n, static_cast<size_t>(unclaimed))); }
+    }
+
+    // Polls for work as set by set_idle_strategy(); true if some showed up.
+    // spinners drops before the caller re-checks pending and parks, so a
+    // submitter that skipped a wakeup because of this worker is never missed.
+    bool spin_for_work(WorkerCounters* counters) {
+        const unsigned spins = spin_count.load(std::memory_order_relaxed);
+        const unsigned yields = yield_count.load(std::memory_order_relaxed);
+        if(spins == 0 && yields == 0) { return false; }
+        return wait_idle(counters, [&]() {
+            ++spinners;
+            bool found = false;
+            for(unsigned ii = 0; ii < spins + yields && !stop.load(std::memory_order_relaxed); ++ii) {
+                if(pending.load(std::memory_order_relaxed) > 0) {
+                    found = true;
+                    break;
+                }
+                if(ii < spins) {
+                    cpu_relax();
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+            --spinners;
+            return found;
+        });
+    }
+
+    // Under SHARED_QUEUE every task sits in a lane and pending only changes
+    // under mtx.
+    void run_shared(WorkerCounters* counters) {
+        local_pool = this;
+        local_counters = counters;
+        StampedTask item;
+        for(;;) {
+            spin_for_work(counters);
+            std::unique_lock<std::mutex> lck(mtx);
+            const auto ready = [&]{ return stop || pending > 0; };
+            ++sleepers;
+            const bool woken = wait_idle(counters, [&]() {
+                if(elastic) { return cv.wait_for(lck, options.idle_timeout, ready); }
+                cv.wait(lck, ready);
+                return true;
+            });
+            --sleepers;
+            if(!woken) {
+                if(live > options.min_threads) {
+                    retire();
+                    return;
+                }
+                continue;
+            }
+            if(stop && pending == 0) { return; }
+            pop_lane(item, false);
+            --pending;
+            maybe_grow();
+            lck.unlock();
+            run_task(item, counters);
+        }
+    }
+
+    bool try_pop_stealing(unsigned index, StampedTask& item) {
+        if(queues[index]->try_pop(item)) { return true; }
+        for(size_t ii = 1; ii < queues.size(); ++ii) {
+            if(queues[(index + ii) % queues.size()]->try_steal(item)) { return true; }
+        }
+        return false;
+    }
+
+    bool try_steal_any(StampedTask& item) {
+        const size_t start = next_queue.load(std::memory_order_relaxed);
+        for(size_t ii = 0; ii < queues.size(); ++ii) {
+            if(queues[(start + ii) % queues.size()]->try_steal(item)) { return true; }
+        }
+        return false;
+    }
+
+    bool pop_lane_locked(StampedTask& item, bool urgent_only) {
+        std::lock_guard<std::mutex> lck(mtx);
+        return pop_lane(item, urgent_only);
+    }
+
+    // Urgent lanes, then the own deque (index < 0: none), then peers' deques,
+    // then the remaining lanes.
+    bool next_task_stealing(int index, StampedTask& item) {
+        if(lane_count > 0 && pop_lane_locked(item, true)) { return true; }
+        if(index >= 0 ? try_pop_stealing(unsigned(index), item) : try_steal_any(item)) { return true; }
+        return lane_count > 0 && pop_lane_locked(item, false);
+    }
+
+    void run_stealing(unsigned index, WorkerCounters* counters) {
+        local_pool = this;
+        local_index = index;
+        local_counters = counters;
+        StampedTask item;
+        for(;;) {
+            if(next_task_stealing(int(index), item)) {
+                --pending;
+                run_task(item, counters);
+                continue;
+            }
+            if(spin_for_work(counters)) { continue; }
+            // sleepers is raised before pending is re-checked, and enqueue()
+            // raises pending before it reads sleepers, so a wakeup is never lost.
+            std::unique_lock<std::mutex> lck(mtx);
+            ++sleepers;
+            wait_idle(counters, [&]() {
+                cv.wait(lck, [&]{ return stop || pending > 0; });
+                return true;
+            });
+            --sleepers;
+            if(stop && pending == 0) { return; }
+        }
+    }
+
 private:
     std::atomic<bool> stop;
-    std::mutex mtx;
+    const SchedulePolicy policy;
+    const bool elastic;
+    const ElasticOptions options;
+    const Placement placement;
+    mutable std::mutex mtx;
     std::condition_variable cv;
+
+    // Workers, their count, how many have ever been started (the placement
+    // index of the next one) and how many are inside a BlockingScope.
+    // threads, spawned and blocked are guarded by mtx.
     std::vector<std::thread> threads;
-    std::queue<std::function<void()>> tasks;
+    std::atomic<unsigned> live;
+    unsigned spawned;
+    unsigned blocked;
+
+    // Elastic pools only: the thread that runs supervise(), and whether it
+    // sleeps until there is queued work and room to grow (guarded by mtx).
+    std::thread supervisor;
+    std::condition_variable supervisor_cv;
+    bool supervisor_idle;
+
+    // Number of workers parked on cv and of workers spinning for work, under
+    // either policy, and the idle strategy.
+    std::atomic<int> sleepers;
+    std::atomic<int> spinners;
+    std::atomic<unsigned> spin_count;
+    std::atomic<unsigned> yield_count;
+
+    // Work-stealing state: one deque per worker, the number of queued tasks
+    // across deques and lanes, and the round-robin cursor for external
+    // submissions.
+    std::vector<std::unique_ptr<WorkStealingQueue>> queues;
+    std::atomic<long> pending;
+    std::atomic<unsigned> next_queue;
+
+    // Priority and deadline lanes, guarded by mtx. lane_count mirrors the
+    // number of queued lane tasks so workers can skip mtx when it is zero.
+    Lane lanes[LANE_COUNT];
+    std::atomic<long> lane_count;
+    std::atomic<uint64_t> missed_deadlines;
+
+    // Stats counters, empty unless THREADPOOL_ENABLE_STATS is defined.
+    // worker_counters and free_counters are guarded by mtx.
+    std::vector<std::unique_ptr<WorkerCounters>> worker_counters;
+    std::vector<WorkerCounters*> free_counters;
+    std::unique_ptr<WorkerCounters> caller_counters;
+
+    inline static thread_local ThreadPool* local_pool = nullptr;
+    inline static thread_local unsigned local_index = 0;
+    inline static thread_local WorkerCounters* local_counters = nullptr;
 };
 
 #endif // _THREADPOOL_H_
@@ -0,0 +1,138 @@
+#ifndef TREE_BARRIER
+#define TREE_BARRIER
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "cpu_relax.hpp"
+#include "futex.hpp"
+
+// Combining-tree barrier for many threads. Threads are grouped under leaf
+// nodes of at most fanin threads; the last to arrive at a node carries on to
+// the parent, and so on up to the root. Releasing runs the other way: every
+// thread that won a node releases it once it is released itself. So no line
+// is touched by more than fanin threads, and each waiter spins on (then
+// sleeps on) the release word of the one node it stopped at. Every node
+// takes two cache lines: arrivals do not disturb the waiters' line.
+//
+// Each participant passes its own id in [0, parties), the same one every
+// phase. As with CyclicBarrier, the thread that completes the root runs the
+// phase callback before anyone is released, and gets true back; if the
+// callback throws, the others are still released before it propagates.
+class TreeBarrier {
+ public:
+  explicit TreeBarrier(unsigned parties, std::function<void()> on_phase = nullptr, unsigned fanin = 4) :
+    fanin_(std::max(2u, fanin)),
+    on_phase_(std::move(on_phase)) {
+    // Build level by level, leaves first; the root ends up last.
+    unsigned width = std::max(1u, parties);
+    int first = 0;
+    for (;;) {
+      const unsigned nodes = (width + fanin_ - 1) / fanin_;
+      for (unsigned idx = 0; idx < nodes; ++idx) {
+        nodes_.emplace_back(std::min(fanin_, width - idx * fanin_));
+      }
+      if (nodes == 1) {
+        break;
+      }
+      const int next = first + static_cast<int>(nodes);
+      for (unsigned idx = 0; idx < nodes; ++idx) {
+        nodes_[first + idx].parent = next + static_cast<int>(idx / fanin_);
+      }
+      first = next;
+      width = nodes;
+    }
+  }
+
+  TreeBarrier(const TreeBarrier&) = delete;
+  TreeBarrier& operator=(const TreeBarrier&) = delete;
+
+  bool ArriveAndWait(unsigned id) {
+    int won[kMaxLevels];
+    int depth = 0;
+    bool last = false;
+    int index = static_cast<int>(id / fanin_);
+    for (;;) {
+      Node& node = nodes_[index];
+      const uint32_t phase = node.release.load(std::memory_order_acquire);
+      if (node.arrived.fetch_add(1, std::memory_order_acq_rel) + 1 != node.expected) {
+        Wait(node, phase);
+        break;
+      }
+      node.arrived.store(0, std::memory_order_relaxed);
+      won[depth++] = index;
+      if (node.parent < 0) {
+        if (on_phase_) {
+          try {
+            on_phase_();
+          } catch (...) {
+            while (depth > 0) {
+              Release(nodes_[won[--depth]]);
+            }
+            throw;
+          }
+        }
+        last = true;
+        break;
+      }
+      index = node.parent;
+    }
+    while (depth > 0) {
+      Release(nodes_[won[--depth]]);
+    }
+    return last;
+  }
+
+  // Number of completed phases.
+  uint32_t Phase() const { return nodes_.back().release.load(std::memory_order_acquire); }
+
+ private:
+  // Enough for any fanin >= 2 and 32-bit party count.
+  static constexpr int kMaxLevels = 33;
+
+  struct Node {
+    explicit Node(unsigned expected) :
+      arrived(0),
+      expected(expected),
+      parent(-1),
+      release(0),
+      sleepers(0) {}
+
+    Node(Node&& rhs) noexcept : Node(rhs.expected) { parent = rhs.parent; }
+
+    alignas(64) std::atomic<uint32_t> arrived;
+    uint32_t expected;
+    int parent;
+    // Bumped when the node is released; the futex word its waiters sleep on.
+    alignas(64) std::atomic<uint32_t> release;
+    std::atomic<uint32_t> sleepers;
+  };
+
+  static void Wait(Node& node, uint32_t phase) {
+    if (spin_until([&]() { return node.release.load(std::memory_order_acquire) != phase; })) {
+      return;
+    }
+    node.sleepers.fetch_add(1);
+    while (node.release.load() == phase) {
+      futex_wait(node.release, phase);
+    }
+    node.sleepers.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  static void Release(Node& node) {
+    node.release.fetch_add(1);
+    if (node.sleepers.load() != 0) {
+      futex_wake_all(node.release);
+    }
+  }
+
+  const unsigned fanin_;
+  const std::function<void()> on_phase_;
+  std::vector<Node> nodes_;
+};
+
+#endif  // TREE_BARRIER